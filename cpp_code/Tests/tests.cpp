@@ -2,7 +2,25 @@
 #include <iomanip>
 #include <cstring>
 #include <random>
+#include <vector>
+#include <algorithm>
 #include "../include/monocypher.hpp"
+#include "../include/helpers.hpp"
+#include "../include/field.hpp"
+#include "../include/polynomial.hpp"
+#include "../include/field_batch.hpp"
+#include "../include/x25519_batch.hpp"
+#include "../include/fixed_base.hpp"
+#include "../include/blake2b_batch.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/drbg.hpp"
+#include "../include/digest_set.hpp"
+#include "../include/bin_table.hpp"
+#include "../include/merkle.hpp"
+#include "../include/network.hpp"
+#include "../include/sender.hpp"
+#include "../include/receiver.hpp"
+#include "../include/intersect.hpp"
 
 int test_elligator() {
     // Step 1: Generate a random scalar b (32 bytes)
@@ -52,6 +70,874 @@ int test_elligator() {
     return 0;
 }
 
+int test_field_arithmetic() {
+    std::mt19937_64 rng(2024);
+    for (int t = 0; t < 1000; t++) {
+        uint256_t a, b;
+        for (size_t i = 0; i < 32; i++) {
+            a.bytes[i] = rng() & 0xFF;
+            b.bytes[i] = rng() & 0xFF;
+        }
+        fe25519 x = fe_from_bytes(a), y = fe_from_bytes(b);
+        fe25519 prod, inv, back, sum, diff, sq, xx, fused, unfused;
+
+        // (x * y) * y^-1 == x
+        fe_mul(prod, x, y);
+        fe_invert(inv, y);
+        fe_mul(back, prod, inv);
+        // (x + y) - y == x
+        fe_add(sum, x, y);
+        fe_sub(diff, sum, y);
+        // x^2 == x * x
+        fe_sq(sq, x);
+        fe_mul(xx, x, x);
+        // x * y + x^2 in one reduction == the two-step version
+        fe_mul_add(fused, x, y, sq);
+        fe_add(unfused, prod, sq);
+
+        if (!fe_equal(back, x) || !fe_equal(diff, x) || !fe_equal(sq, xx) || !fe_equal(fused, unfused)) {
+            std::cout << "Error: field identity failed at iteration " << t << std::endl;
+            return 1;
+        }
+    }
+
+    // p itself and 2^256 - 1 must encode canonically (as 0 and 37)
+    uint256_t p_bytes, max_bytes, expected;
+    memset(p_bytes.bytes, 0xFF, 32);
+    p_bytes.bytes[0] = 0xED;
+    p_bytes.bytes[31] = 0x7F;
+    memset(max_bytes.bytes, 0xFF, 32);
+    memset(expected.bytes, 0, 32);
+    if (!(fe_to_bytes(fe_from_bytes(p_bytes)) == expected)) {
+        std::cout << "Error: p does not encode to 0" << std::endl;
+        return 1;
+    }
+    expected.bytes[0] = 37;
+    if (!(fe_to_bytes(fe_from_bytes(max_bytes)) == expected)) {
+        std::cout << "Error: 2^256 - 1 does not encode to 37" << std::endl;
+        return 1;
+    }
+
+    // Word multipliers near 2^64: the carry out of bit 256 is then close to
+    // 2^64. With f = 2^256 - 37, small = 2^64 - 1 and a = 38, folding it once
+    // leaves bits 0..63 at 2^64 - 1 with one more carry still to add.
+    fe25519 ones = {{UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX}};
+    fe25519 edge = {{UINT64_MAX - 36, UINT64_MAX, UINT64_MAX, UINT64_MAX}};
+    for (uint64_t small : {UINT64_MAX, UINT64_MAX - 37, UINT64_C(1) << 63, (uint64_t)rng()}) {
+        for (const fe25519 &f : {ones, edge, fe_from_u64(rng())}) {
+            for (const fe25519 &a : {ones, fe_from_u64(38)}) {
+                fe25519 fused, prod, unfused;
+                fe_mul_small_add(fused, f, small, a);
+                fe_mul(prod, f, fe_from_u64(small));
+                fe_add(unfused, prod, a);
+                if (!fe_equal(fused, unfused)) {
+                    std::cout << "Error: fe_mul_small_add differs from fe_mul for small = " << std::dec
+                              << small << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    std::cout << "Success: field arithmetic identities hold!" << std::endl;
+    return 0;
+}
+
+int test_lagrange() {
+    std::mt19937_64 rng(7);
+    // 20 points use the quadratic path, 200 the subproduct tree
+    for (size_t n : {20, 200}) {
+        std::vector<uint256_t> xs(n), ys(n);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < 32; j++) {
+                xs[i].bytes[j] = rng() & 0xFF;
+                ys[i].bytes[j] = rng() & 0xFF;
+            }
+            xs[i] = fe_to_bytes(fe_from_bytes(xs[i]));
+            ys[i] = fe_to_bytes(fe_from_bytes(ys[i]));
+        }
+
+        std::vector<uint256_t> poly = Lagrange_Polynomial(xs, ys);
+        for (size_t i = 0; i < n; i++) {
+            if (!(evaluate_poly(poly, xs[i].bytes) == ys[i])) {
+                std::cout << "Error: interpolated polynomial misses point " << i << std::endl;
+                return 1;
+            }
+        }
+
+        // Duplicate x-coordinates must be rejected
+        xs[n - 1] = xs[n / 2];
+        try {
+            Lagrange_Polynomial(xs, ys);
+            std::cout << "Error: duplicate x-coordinate was not detected" << std::endl;
+            return 1;
+        } catch (const std::runtime_error&) {
+        }
+    }
+
+    std::cout << "Success: Lagrange interpolation passes through all points!" << std::endl;
+    return 0;
+}
+
+int test_multipoint_eval() {
+    std::mt19937_64 rng(11);
+    fe_poly f(40);
+    std::vector<fe25519> points(300), fast(300);
+    for (auto& c : f) {
+        c = fe25519{{rng(), rng(), rng(), rng()}};
+    }
+    for (auto& x : points) {
+        x = fe25519{{rng(), rng(), rng(), rng()}};
+    }
+
+    // 300 points takes the subproduct-tree path
+    multipoint_eval(fast.data(), f, points.data(), points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        if (!fe_equal(fast[i], poly_eval(f, points[i]))) {
+            std::cout << "Error: multipoint evaluation differs from Horner at point " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Divisions large enough for the Newton path: f mod M agrees with f at
+    // the roots of M, also as remainders inside a tree of 600 points
+    fe_poly g(700);
+    for (auto& c : g) {
+        c = fe25519{{rng(), rng(), rng(), rng()}};
+    }
+    SubproductTree small_tree(points.data(), 150);
+    fe_poly r;
+    poly_rem_monic(r, g, small_tree.root());
+    std::vector<fe25519> many(600), many_fast(600);
+    for (auto& x : many) {
+        x = fe25519{{rng(), rng(), rng(), rng()}};
+    }
+    multipoint_eval(many_fast.data(), g, many.data(), many.size());
+    for (size_t i = 0; i < many.size(); i++) {
+        if ((i < 150 && (r.size() != 150 || !fe_equal(poly_eval(r, points[i]), poly_eval(g, points[i])))) ||
+            !fe_equal(many_fast[i], poly_eval(g, many[i]))) {
+            std::cout << "Error: Newton division differs from Horner at point " << i << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Success: multipoint evaluation matches Horner!" << std::endl;
+    return 0;
+}
+
+int test_field_batch() {
+    std::mt19937_64 rng(3);
+    // 7 elements: one full group of four plus a partial group
+    std::vector<fe25519> a(7), b(7), prod(7), sq(7), evals(7);
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] = fe25519{{rng(), rng(), rng(), rng()}};
+        b[i] = fe25519{{rng(), rng(), rng(), rng()}};
+    }
+    fe_mul_batch(prod.data(), a.data(), b.data(), a.size());
+    fe_sq_batch(sq.data(), a.data(), a.size());
+    fe_poly_eval_batch(evals.data(), b.data(), b.size(), a.data(), a.size());
+
+    fe_poly f(b.begin(), b.end());
+    for (size_t i = 0; i < a.size(); i++) {
+        fe25519 p, s;
+        fe_mul(p, a[i], b[i]);
+        fe_sq(s, a[i]);
+        if (!fe_equal(p, prod[i]) || !fe_equal(s, sq[i]) || !fe_equal(evals[i], poly_eval(f, a[i]))) {
+            std::cout << "Error: batch field kernel differs from scalar at element " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Every specialized length, and a few generic ones past the table
+    std::vector<fe25519> coeffs(POLY_EVAL_SPECIALIZED_MAX + 4);
+    for (auto &c : coeffs) c = fe25519{{rng(), rng(), rng(), rng()}};
+    for (size_t len = 1; len <= coeffs.size(); len++) {
+        fe_poly_eval_batch(evals.data(), coeffs.data(), len, a.data(), a.size());
+        fe_poly g(coeffs.begin(), coeffs.begin() + len);
+        for (size_t i = 0; i < a.size(); i++) {
+            if (!fe_equal(evals[i], poly_eval(g, a[i]))) {
+                std::cout << "Error: evaluation of " << len << " coefficients differs from Horner" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Lockstep: seven points spread over the two quadratics packed in a
+    std::vector<fe25519> lockstep(7);
+    const size_t which[7] = {1, 0, 1, 1, 0, 0, 1};
+    fe_poly_eval_lockstep(lockstep.data(), a.data(), 3, which, b.data(), b.size());
+    for (size_t i = 0; i < b.size(); i++) {
+        fe_poly g(a.begin() + 3 * which[i], a.begin() + 3 * which[i] + 3);
+        if (!fe_equal(lockstep[i], poly_eval(g, b[i]))) {
+            std::cout << "Error: lockstep evaluation differs from Horner at point " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Aligned container: round trip through fe25519 and bytes
+    FieldBatch fa = FieldBatch::from_fe(a.data(), a.size());
+    std::vector<uint256_t> bytes = fa.to_bytes();
+    FieldBatch fback = FieldBatch::from_bytes(bytes.data(), bytes.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!fe_equal(fa.get(i), a[i]) || !fe_equal(fback.get(i), a[i]) || !(bytes[i] == fe_to_bytes(a[i]))) {
+            std::cout << "Error: FieldBatch round trip differs at element " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Integer progression: word-multiplier Horner at first, first + 1, ...
+    std::vector<fe25519> progression(3 * coeffs.size());
+    for (size_t len : {(size_t)1, (size_t)4, coeffs.size()}) {
+        fe_poly g(coeffs.begin(), coeffs.begin() + len);
+        fe_poly_eval_progression(progression.data(), g.data(), len, 1000, progression.size());
+        for (size_t j = 0; j < progression.size(); j++) {
+            if (!fe_equal(progression[j], poly_eval(g, fe_from_u64(1000 + j)))) {
+                std::cout << "Error: progression evaluation differs from Horner at point " << j << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << "Success: batch field kernels (" << (field_batch_avx2() ? "avx2" : "portable")
+              << ") match scalar code!" << std::endl;
+    return 0;
+}
+
+int test_x25519_batch() {
+    std::mt19937_64 rng(5);
+    // 10 elements: two full AVX2 groups plus a scalar tail
+    std::vector<uint256_t> scalars(10), points(10), out(10);
+    for (size_t i = 0; i < scalars.size(); i++) {
+        for (size_t j = 0; j < 32; j++) {
+            scalars[i].bytes[j] = rng() & 0xFF;
+            points[i].bytes[j] = rng() & 0xFF;
+        }
+    }
+    // Edge cases: the zero point and a point with bit 255 set
+    memset(points[1].bytes, 0, 32);
+    memset(points[2].bytes, 0xFF, 32);
+
+    // Batch sizes 3 and 256 exercise partial and single shared inversions
+    for (size_t batch_size : {3, 256}) {
+        x25519_batch(out.data(), scalars.data(), points.data(), scalars.size(), batch_size);
+        for (size_t i = 0; i < scalars.size(); i++) {
+            uint256_t expected;
+            crypto_x25519(expected.bytes, scalars[i].bytes, points[i].bytes);
+            if (!(out[i] == expected)) {
+                std::cout << "Error: x25519_batch differs from crypto_x25519 at element " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Field-form points, one scalar; canonical bytes as the reference
+    FieldBatch fpoints = FieldBatch::from_bytes(points.data(), points.size());
+    std::vector<uint256_t> canonical = fpoints.to_bytes();
+    for (size_t batch_size : {3, 256}) {
+        x25519_batch(out.data(), scalars[0], fpoints, batch_size);
+        for (size_t i = 0; i < points.size(); i++) {
+            uint256_t expected;
+            crypto_x25519(expected.bytes, scalars[0].bytes, canonical[i].bytes);
+            if (!(out[i] == expected)) {
+                std::cout << "Error: x25519_batch on a FieldBatch differs at element " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << "Success: x25519_batch matches crypto_x25519!" << std::endl;
+    return 0;
+}
+
+int test_fixed_base() {
+    std::mt19937_64 rng(13);
+    std::vector<uint256_t> scalars(10), out(10);
+    for (auto& s : scalars) {
+        for (size_t j = 0; j < 32; j++) {
+            s.bytes[j] = rng() & 0xFF;
+        }
+    }
+
+    // Generator table against crypto_x25519_public_key
+    FixedBaseTable::generator().scalarmult_batch(out.data(), scalars.data(), scalars.size());
+    for (size_t i = 0; i < scalars.size(); i++) {
+        uint256_t expected;
+        crypto_x25519_public_key(expected.bytes, scalars[i].bytes);
+        if (!(out[i] == expected)) {
+            std::cout << "Error: generator table differs from crypto_x25519_public_key at " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Per-session table for a curve point, and fallback for a twist point
+    uint256_t base = out[0], twist = uint256_t();
+    twist.bytes[0] = 2;
+    for (const uint256_t& point : {base, twist}) {
+        x25519_fixed_base_batch(out.data(), scalars.data(), point, scalars.size());
+        for (size_t i = 0; i < scalars.size(); i++) {
+            uint256_t expected;
+            crypto_x25519(expected.bytes, scalars[i].bytes, point.bytes);
+            if (!(out[i] == expected)) {
+                std::cout << "Error: fixed-base table differs from crypto_x25519 at " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << "Success: fixed-base tables match crypto_x25519!" << std::endl;
+    return 0;
+}
+
+int test_blake2b_batch() {
+    // Lengths on both sides of the one-block limit, odd count for the tail
+    const size_t n = 7;
+    uint8_t messages[n * 160];
+    for (size_t i = 0; i < sizeof(messages); i++) {
+        messages[i] = (uint8_t)(i * 131 + 7);
+    }
+    for (size_t msg_len : {0, 32, 64, 128, 129}) {
+        uint256_t out[n];
+        blake2b_256_batch(out, messages, msg_len, 160, n);
+        for (size_t i = 0; i < n; i++) {
+            uint256_t expected;
+            crypto_blake2b(expected.bytes, 32, messages + 160 * i, msg_len);
+            if (!(out[i] == expected)) {
+                std::cout << "Error: blake2b_256_batch differs from crypto_blake2b for length " << msg_len << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // The batch hashes must agree with the single-message ones, in place too
+    vector<uint256_t> a(n), b(n), h(n);
+    for (size_t i = 0; i < n; i++) {
+        memcpy(a[i].bytes, messages + 32 * i, 32);
+        memcpy(b[i].bytes, messages + 32 * (i + n), 32);
+    }
+    concatenate_and_hash_batch(h.data(), a.data(), b.data(), n);
+    for (size_t i = 0; i < n; i++) {
+        if (!(h[i] == concatenate_and_hash(a[i], b[i]))) {
+            std::cout << "Error: concatenate_and_hash_batch differs at " << i << std::endl;
+            return 1;
+        }
+    }
+    h = a;
+    H_1_batch(h.data(), h.data(), n);
+    for (size_t i = 0; i < n; i++) {
+        if (!(h[i] == H_1(a[i]))) {
+            std::cout << "Error: H_1_batch differs at " << i << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Success: blake2b_256_batch matches crypto_blake2b!" << std::endl;
+    return 0;
+}
+
+int test_thread_pool() {
+    ThreadPool pool(4);
+
+    // Every index visited exactly once, including from nested calls
+    vector<int> visits(10000, 0);
+    pool.parallel_for(0, 100, 7, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            pool.parallel_for(100 * i, 100 * (i + 1), 16, [&](size_t a, size_t b) {
+                for (size_t j = a; j < b; j++) visits[j]++;
+            });
+        }
+    });
+    for (size_t i = 0; i < visits.size(); i++) {
+        if (visits[i] != 1) {
+            std::cout << "Error: parallel_for visited index " << i << " " << visits[i] << " times" << std::endl;
+            return 1;
+        }
+    }
+
+    // A single thread still honours the grain, in order
+    ThreadPool alone(1);
+    size_t next = 0;
+    alone.parallel_for(0, 10, 3, [&](size_t lo, size_t hi) {
+        if (lo == next && hi - lo <= 3) next = hi;
+    });
+    if (next != 10) {
+        std::cout << "Error: single-thread parallel_for ignored the grain" << std::endl;
+        return 1;
+    }
+
+    // Exceptions thrown by a task reach the caller
+    bool caught = false;
+    try {
+        pool.parallel_for(0, 64, 1, [](size_t lo, size_t) {
+            if (lo == 37) throw runtime_error("task failed");
+        });
+    } catch (const runtime_error&) {
+        caught = true;
+    }
+    if (!caught) {
+        std::cout << "Error: parallel_for dropped a task exception" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Success: thread pool covers every index once!" << std::endl;
+    return 0;
+}
+
+int test_drbg() {
+    // Same key, same requests (buffered and bulk): same stream
+    uint8_t key[32] = {1, 2, 3};
+    ChaChaDrbg first(key), second(key);
+    vector<uint256_t> a(100), b(100);
+    first.fill(a.data(), 1);
+    first.fill(a.data() + 1, 99);
+    second.fill(b.data(), 1);
+    second.fill(b.data() + 1, 99);
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!(a[i] == b[i])) {
+            std::cout << "Error: seeded ChaChaDrbg streams differ at " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Consecutive outputs never repeat the first one
+    uint256_t c, d;
+    first.fill(&c, 1);
+    first.fill(&d, 1);
+    if (c == d || c == a[0]) {
+        std::cout << "Error: ChaChaDrbg repeated an output" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Success: ChaChaDrbg streams are reproducible!" << std::endl;
+    return 0;
+}
+
+int test_digest_set() {
+    vector<uint256_t> keys(1000), others(1000);
+    ChaChaDrbg::local().fill(keys.data(), keys.size());
+    ChaChaDrbg::local().fill(others.data(), others.size());
+    // Keys sharing their leading bytes must not collide either
+    for (size_t i = 0; i < 100; i++) {
+        memset(keys[i].bytes, 0xab, 24);
+    }
+
+    DigestSet set;
+    for (const auto& key : keys) set.insert(key);
+    if (set.insert(keys[17]) || set.size() != keys.size()) {
+        std::cout << "Error: DigestSet accepted a duplicate" << std::endl;
+        return 1;
+    }
+
+    vector<uint256_t> queries(keys);
+    queries.insert(queries.end(), others.begin(), others.end());
+    vector<uint8_t> found(queries.size());
+    set.contains_batch(found.data(), queries.data(), queries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        bool expected = i < keys.size();
+        if (found[i] != expected || set.contains(queries[i]) != expected) {
+            std::cout << "Error: DigestSet lookup wrong for query " << i << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Success: DigestSet finds exactly the inserted digests!" << std::endl;
+    return 0;
+}
+
+int test_bin_table() {
+    // Bin 1 and the last bin stay empty but keep their directory entries
+    const size_t n = 6, num_bins = 4;
+    uint256_t values[n];
+    size_t bins[n] = {2, 0, 2, 0, 0, 2};
+    for (size_t i = 0; i < n; i++) {
+        values[i] = uint256_t();
+        values[i].bytes[0] = (uint8_t)i;
+    }
+    BinTable table = build_bin_table(values, bins, n, num_bins);
+
+    const size_t expected_offsets[num_bins + 1] = {0, 3, 3, 6, 6};
+    const uint8_t expected_order[n] = {1, 3, 4, 0, 2, 5};
+    for (size_t b = 0; b <= num_bins; b++) {
+        if (table.bin_offsets[b] != expected_offsets[b]) {
+            std::cout << "Error: bin table offset " << b << " is " << table.bin_offsets[b] << std::endl;
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (table.values[i].bytes[0] != expected_order[i]) {
+            std::cout << "Error: bin table did not keep input order within bins" << std::endl;
+            return 1;
+        }
+    }
+    if (table.num_bins() != num_bins || !table.bin_empty(1) || table.bin(2)[1].bytes[0] != 2) {
+        std::cout << "Error: bin table directory is wrong" << std::endl;
+        return 1;
+    }
+
+    // Enough bins for the two-level partition; compare with a plain stable sort
+    const size_t big_n = 50000, big_bins = 5000;
+    vector<size_t> big(big_n);
+    for (size_t i = 0; i < big_n; i++) {
+        big[i] = (i * 2654435761u) % big_bins;
+    }
+    BinPartition partition = partition_bins(big.data(), big_n, big_bins);
+    vector<size_t> order(big_n);
+    for (size_t i = 0; i < big_n; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return big[x] < big[y]; });
+    if (partition.members != order || partition.bin_offsets[big_bins] != big_n ||
+        partition.bin_size(big[0]) == 0) {
+        std::cout << "Error: partition_bins differs from a stable sort by bin" << std::endl;
+        return 1;
+    }
+
+    // Singletons move to the next non-empty bin, the last one wrapping
+    // around; the element indices travel with them
+    size_t sparse[6] = {0, 0, 3, 5, 5, 9};
+    BinPartition rebalanced = rebalance_singletons(partition_bins(sparse, 6, 10));
+    const size_t expected_members[6] = {0, 1, 5, 3, 4, 2};
+    const size_t expected_sizes[10] = {3, 0, 0, 0, 0, 3, 0, 0, 0, 0};
+    for (size_t b = 0; b < 10; b++) {
+        if (rebalanced.bin_size(b) != expected_sizes[b]) {
+            std::cout << "Error: rebalanced bin " << b << " has " << rebalanced.bin_size(b) << " elements" << std::endl;
+            return 1;
+        }
+    }
+    for (size_t k = 0; k < 6; k++) {
+        if (rebalanced.members[k] != expected_members[k]) {
+            std::cout << "Error: rebalancing lost track of element indices" << std::endl;
+            return 1;
+        }
+    }
+
+    // Cached digests place every element where its slot says
+    DigestTable digests;
+    digests.compute(values, n);
+    digests.assign_bins(3);
+    for (size_t i = 0; i < n; i++) {
+        if (!(digests.h1[i] == H_1(values[i])) ||
+            digests.bins[i] != H_bin(H_1(digests.h1[i]).bytes, 3) ||
+            digests.partition.bin(digests.bins[i])[digests.slots[i]] != i) {
+            std::cout << "Error: digest table misplaces element " << i << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Success: bin table keeps every bin, empty ones included!" << std::endl;
+    return 0;
+}
+
+// count distinct random values that all have the same two cuckoo
+// candidates among num_bins bins, so together they overflow both.
+static vector<uint256_t> same_candidates(size_t count, size_t num_bins) {
+    vector<vector<uint256_t>> by_pair(num_bins * num_bins);
+    while (true) {
+        vector<uint256_t> values(4096);
+        ChaChaDrbg::local().fill(values.data(), values.size());
+        DigestTable digests;
+        digests.compute(values.data(), values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            size_t b0 = candidate_bin(digests.bin_hash[i], 0, num_bins);
+            size_t b1 = candidate_bin(digests.bin_hash[i], 1, num_bins);
+            vector<uint256_t> &group = by_pair[std::min(b0, b1) * num_bins + std::max(b0, b1)];
+            group.push_back(values[i]);
+            if (group.size() == count) return group;
+        }
+    }
+}
+
+int test_bin_strategies() {
+    // Every element lands in one of its candidates (or the cuckoo stash),
+    // and both strategies keep the largest bin close to the average
+    const size_t n = 4096, num_bins = 4096 / 12;
+    vector<uint256_t> values(n);
+    ChaChaDrbg::local().fill(values.data(), n);
+    DigestTable digests;
+    digests.compute(values.data(), n);
+
+    const BinStrategy strategies[2] = {BinStrategy::TWO_CHOICE, BinStrategy::CUCKOO};
+    for (BinStrategy strategy : strategies) {
+        digests.assign_bins(num_bins, strategy);
+        bool cuckoo = strategy == BinStrategy::CUCKOO;
+        size_t per_element;
+        vector<size_t> pairs = candidate_pairs(digests, num_bins, strategy, cuckoo, per_element);
+        for (size_t i = 0; i < n; i++) {
+            bool found = false;
+            for (size_t j = 0; j < per_element; j++) {
+                found |= pairs[i * per_element + j] == digests.bins[i];
+            }
+            if (!found || digests.partition.bin(digests.bins[i])[digests.slots[i]] != i ||
+                candidate_bin(digests.bin_hash[i], 0, num_bins) == candidate_bin(digests.bin_hash[i], 1, num_bins)) {
+                std::cout << "Error: element " << i << " is not in a candidate bin" << std::endl;
+                return 1;
+            }
+        }
+        size_t stash = cuckoo ? digests.partition.bin_size(num_bins) : 0;
+        if (digests.partition.num_bins() != num_bins + (cuckoo ? 1 : 0) ||
+            stash > CUCKOO_STASH_SIZE || digests.max_load > n / num_bins + 4) {
+            std::cout << "Error: bin strategy load " << digests.max_load << " is too high" << std::endl;
+            return 1;
+        }
+    }
+
+    // Overflowing two bins of 64 elements: a few extra elements go to the
+    // stash, too many for the stash raise the capacity instead
+    const size_t small_n = 64, small_bins = 10, capacity = small_n / small_bins + 2;
+    for (size_t crowded : {2 * capacity + 3, 2 * capacity + CUCKOO_STASH_SIZE + 5}) {
+        vector<uint256_t> crowd = same_candidates(crowded, small_bins);
+        crowd.resize(small_n);
+        ChaChaDrbg::local().fill(crowd.data() + crowded, small_n - crowded);
+        DigestTable small;
+        small.compute(crowd.data(), crowd.size());
+        small.assign_bins(small_bins, BinStrategy::CUCKOO);
+        size_t stashed = small.partition.bin_size(small_bins);
+        bool restarted = small.max_load > capacity;
+        if (stashed == 0 || stashed > CUCKOO_STASH_SIZE ||
+            restarted != (crowded > 2 * capacity + CUCKOO_STASH_SIZE)) {
+            std::cout << "Error: " << std::dec << crowded << " crowded elements stash " << stashed << std::endl;
+            return 1;
+        }
+    }
+
+    // Dummies only ever extend a bin
+    vector<uint256_t> xs(1), ys(1);
+    pad_with_dummies(xs, ys, 5);
+    pad_with_dummies(xs, ys, 2);
+    if (xs.size() != 5 || ys.size() != 5) {
+        std::cout << "Error: padding produced the wrong bin size" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Success: two-choice and cuckoo bins stay balanced!" << std::endl;
+    return 0;
+}
+
+int test_merkle() {
+    // Single block, several blocks, and short last blocks of 1 and 5 leaves,
+    // against the level-by-level reference
+    const size_t B = MERKLE_BLOCK_LEAVES;
+    vector<uint256_t> leaves(3 * B + 5);
+    ChaChaDrbg::local().fill(leaves.data(), leaves.size());
+    for (size_t n : {(size_t)1, (size_t)2, (size_t)7, B, B + 1, 3 * B + 5}) {
+        vector<uint256_t> level(leaves.begin(), leaves.begin() + n);
+        while (level.size() > 1) {
+            level = Merkle_Next_Level(level);
+        }
+        vector<uint256_t> work(leaves.begin(), leaves.begin() + n);
+        if (!(merkle_root(leaves.data(), n) == level[0]) ||
+            !(merkle_root_in_place(work.data(), n) == level[0])) {
+            std::cout << "Error: Merkle root of " << n << " leaves differs from the reference" << std::endl;
+            return 1;
+        }
+    }
+
+    // Streaming: leaves one at a time and in uneven batches, root checked
+    // along the way
+    MerkleAccumulator single, batched;
+    size_t added = 0;
+    for (size_t batch : {(size_t)3, B - 1, 2 * B + 1, (size_t)1}) {
+        for (size_t i = added; i < added + batch; i++) {
+            single.add(leaves[i]);
+        }
+        batched.add(leaves.data() + added, batch);
+        added += batch;
+        uint256_t expected = merkle_root(leaves.data(), added);
+        if (!(single.root() == expected) || !(batched.root() == expected) || batched.size() != added) {
+            std::cout << "Error: streaming Merkle root differs after " << added << " leaves" << std::endl;
+            return 1;
+        }
+    }
+
+    // 4- and 8-ary trees against a direct reference: the last group of a
+    // level is padded with copies of its last node
+    for (size_t arity : {(size_t)4, (size_t)8}) {
+        for (size_t n : {(size_t)1, (size_t)5, B, B + 3, 3 * B + 5}) {
+            vector<uint256_t> level(leaves.begin(), leaves.begin() + n);
+            while (level.size() > 1) {
+                vector<uint256_t> next;
+                for (size_t i = 0; i < level.size(); i += arity) {
+                    vector<uint256_t> group(arity, level[std::min(i + arity, level.size()) - 1]);
+                    std::copy(level.begin() + i, level.begin() + std::min(i + arity, level.size()), group.begin());
+                    uint256_t node;
+                    crypto_blake2b(node.bytes, 32, group[0].bytes, 32 * arity);
+                    next.push_back(node);
+                }
+                level = next;
+            }
+            MerkleAccumulator stream(arity);
+            stream.add(leaves.data(), 2);
+            stream.add(leaves.data() + 2, n - std::min(n, (size_t)2));
+            vector<uint256_t> work(leaves.begin(), leaves.begin() + n);
+            if (!(merkle_root(leaves.data(), n, arity) == level[0]) ||
+                !(merkle_root_in_place(work.data(), n, arity) == level[0]) ||
+                (n >= 2 && !(stream.root() == level[0]))) {
+                std::cout << "Error: " << arity << "-ary Merkle root of " << n << " leaves differs" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Persisted tree: same root, proofs that verify and break when altered,
+    // and a saved copy that maps back unchanged
+    for (size_t arity : {(size_t)2, (size_t)4, (size_t)8}) {
+        for (size_t n : {(size_t)1, (size_t)6, 3 * B + 5}) {
+            MerkleTree tree(leaves.data(), n, arity);
+            if (!(tree.root() == merkle_root(leaves.data(), n, arity))) {
+                std::cout << "Error: stored " << arity << "-ary tree of " << n << " leaves has the wrong root" << std::endl;
+                return 1;
+            }
+            const size_t indices[3] = {0, n / 2, n - 1};
+            vector<uint256_t> proofs = tree.prove(indices, 3);
+            for (size_t i = 0; i < 3; i++) {
+                const uint256_t *proof = proofs.data() + i * tree.proof_length();
+                uint256_t other = leaves[indices[i]];
+                other.bytes[0] ^= 1;
+                if (!merkle_verify(tree.root(), leaves[indices[i]], indices[i], n, arity, proof) ||
+                    merkle_verify(tree.root(), other, indices[i], n, arity, proof)) {
+                    std::cout << "Error: inclusion proof of leaf " << indices[i] << " is wrong" << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    const char *path = "merkle_test.tree";
+    MerkleTree saved(leaves.data(), leaves.size(), 4);
+    saved.save(path);
+    {
+        MerkleTree mapped = MerkleTree::load(path);
+        vector<uint256_t> proof(mapped.proof_length());
+        mapped.prove(proof.data(), 1234);
+        if (!(mapped.root() == saved.root()) || mapped.size() != saved.size() ||
+            !merkle_verify(saved.root(), leaves[1234], 1234, leaves.size(), 4, proof.data())) {
+            std::cout << "Error: mapped Merkle tree differs from the saved one" << std::endl;
+            remove(path);
+            return 1;
+        }
+    }
+    // Corrupt files must be rejected: a leaf count whose level sizes wrap
+    // around, and a tree missing its root
+    for (uint64_t leaves_field : {(uint64_t)1 << 63, (uint64_t)7}) {
+        FILE *f = fopen(path, "wb");
+        uint64_t header[4] = {0, leaves_field, 2, 0};
+        memcpy(header, "APSIMRK1", 8);
+        fwrite(header, sizeof(header), 1, f);
+        fwrite(leaves.data(), sizeof(uint256_t), 12, f);
+        fclose(f);
+        bool rejected = false;
+        try {
+            MerkleTree::load(path);
+        } catch (const std::runtime_error &) {
+            rejected = true;
+        }
+        if (!rejected) {
+            std::cout << "Error: corrupt Merkle tree file was accepted" << std::endl;
+            remove(path);
+            return 1;
+        }
+    }
+
+    // A sender with a tree path saves its commitment; a restarted sender on
+    // the same input maps it back, and one on another input rebuilds it
+    std::string rand_path = std::string(path) + ".rand";
+    Sender first(leaves.data(), 1000);
+    first.merkle_arity = 4;
+    first.merkle_tree_path = path;
+    first.commit();
+    Sender restarted(leaves.data(), 1000);
+    restarted.merkle_arity = 4;
+    restarted.merkle_tree_path = path;
+    restarted.commit();
+    vector<uint256_t> sender_proof(restarted.merkle_tree.proof_length());
+    restarted.merkle_tree.prove(sender_proof.data(), 999);
+    leaves[0].bytes[0] ^= 1;
+    Sender changed(leaves.data(), 1000);
+    changed.merkle_arity = 4;
+    changed.merkle_tree_path = path;
+    changed.commit();
+    leaves[0].bytes[0] ^= 1;
+    remove(path);
+    remove(rand_path.c_str());
+    if (!(first.merkle_root == merkle_root(first.merkle_leaves.data(), 1000, 4)) ||
+        !(restarted.merkle_root == first.merkle_root) || restarted.merkle_leaves != first.merkle_leaves ||
+        !merkle_verify(first.merkle_root, first.merkle_leaves[999], 999, 1000, 4, sender_proof.data())) {
+        std::cout << "Error: restarted sender does not reuse its saved commitment" << std::endl;
+        return 1;
+    }
+    if (changed.merkle_root == first.merkle_root ||
+        !(changed.merkle_root == merkle_root(changed.merkle_leaves.data(), 1000, 4))) {
+        std::cout << "Error: sender reused a commitment saved for another input" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Success: Merkle roots, stored trees and proofs match the reference!" << std::endl;
+    return 0;
+}
+
+int test_padded_stash() {
+    // A receiver whose cuckoo stash is in use, in --pad mode: the sender's
+    // stash holds all its elements, but must not set the padded load of the
+    // regular bins
+    const size_t receiver_n = 64, sender_n = 256;
+    size_t num_bins = receiver_n / log2(receiver_n);
+    vector<uint256_t> receiver_input = same_candidates(2 * (receiver_n / num_bins + 2) + 3, num_bins);
+    size_t crowded = receiver_input.size();
+    receiver_input.resize(receiver_n);
+    ChaChaDrbg::local().fill(receiver_input.data() + crowded, receiver_n - crowded);
+    vector<uint256_t> sender_input(sender_n);
+    ChaChaDrbg::local().fill(sender_input.data(), sender_n);
+
+    Receiver receiver(receiver_input.data(), receiver_n);
+    receiver.bin_config.strategy = BinStrategy::CUCKOO;
+    receiver.bin_config.pad = true;
+    Sender sender(sender_input.data(), sender_n);
+    receiver.commit();
+    sender.commit();
+    if (receiver.polys.bin_empty(num_bins)) {
+        std::cout << "Error: crowded receiver did not use its stash" << std::endl;
+        return 1;
+    }
+    // Fixed-degree mode leaves an unused stash empty, so the sender does
+    // not add its elements to it
+    Receiver spread(sender_input.data(), receiver_n);
+    spread.bin_config.strategy = BinStrategy::CUCKOO;
+    spread.bin_config.fixed_degree = true;
+    spread.commit();
+    if (spread.digests.partition.bin_size(num_bins) == 0 && !spread.polys.bin_empty(num_bins)) {
+        std::cout << "Error: fixed-degree mode filled an unused stash" << std::endl;
+        return 1;
+    }
+
+    NetworkSimulator net(0, 0, 10000000);
+    intersect(receiver, sender, net);
+    // Leaves, the stash and m take 2 * sender_n + 2 values; the regular bins
+    // hold two candidates of every element plus dummies, far below sender_n
+    // each
+    size_t sent = net.totalServerToClient() / 32;
+    if (sent > 2 * sender_n + 2 + num_bins * sender_n / 2) {
+        std::cout << "Error: padded sender bins take " << std::dec << sent << " values" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Success: padding leaves the stash alone!" << std::endl;
+    return 0;
+}
+
 int main() {
-    return test_elligator();
+    // Exercise the parallel paths even on a single-core machine
+    ThreadPool::set_default_threads(4);
+    int failures = 0;
+    failures += test_elligator();
+    failures += test_field_arithmetic();
+    failures += test_lagrange();
+    failures += test_multipoint_eval();
+    failures += test_field_batch();
+    failures += test_x25519_batch();
+    failures += test_fixed_base();
+    failures += test_blake2b_batch();
+    failures += test_thread_pool();
+    failures += test_drbg();
+    failures += test_digest_set();
+    failures += test_bin_table();
+    failures += test_bin_strategies();
+    failures += test_merkle();
+    failures += test_padded_stash();
+    return failures;
 }
\ No newline at end of file
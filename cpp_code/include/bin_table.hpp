@@ -0,0 +1,132 @@
+#ifndef BIN_TABLE_HPP
+#define BIN_TABLE_HPP
+
+#include <cstddef>
+#include <vector>
+#include "helpers.hpp"
+
+// Bins of 32-byte values in compressed sparse row form.
+//
+// All bins share one buffer, back to back; bin b is
+// values[bin_offsets[b] .. bin_offsets[b + 1]). Every bin has a directory
+// entry, so an empty bin is simply two equal offsets and bin indices stay
+// valid whether or not earlier bins are empty.
+struct BinTable {
+    vector<uint256_t> values;
+    vector<size_t> bin_offsets;
+
+    BinTable() : bin_offsets(1, 0) {}
+    explicit BinTable(size_t num_bins) : bin_offsets(num_bins + 1, 0) {}
+
+    size_t num_bins() const { return bin_offsets.size() - 1; }
+    size_t bin_size(size_t b) const { return bin_offsets[b + 1] - bin_offsets[b]; }
+    bool bin_empty(size_t b) const { return bin_offsets[b + 1] == bin_offsets[b]; }
+
+    uint256_t *bin(size_t b) { return values.data() + bin_offsets[b]; }
+    const uint256_t *bin(size_t b) const { return values.data() + bin_offsets[b]; }
+
+    // Appends a new last bin holding count values.
+    void push_bin(const uint256_t *first, size_t count);
+};
+
+// Element indices grouped by bin, same directory layout as BinTable; within
+// a bin the indices are ascending.
+struct BinPartition {
+    vector<size_t> members;
+    vector<size_t> bin_offsets;
+
+    size_t num_bins() const { return bin_offsets.size() - 1; }
+    size_t bin_size(size_t b) const { return bin_offsets[b + 1] - bin_offsets[b]; }
+    const size_t *bin(size_t b) const { return members.data() + bin_offsets[b]; }
+};
+
+// Groups 0 .. n-1 by bins[i] in three parallel passes: per-block histograms
+// of coarse buckets, a prefix sum, and a scatter through small per-bucket
+// write buffers; each bucket is then split into its bins on its own.
+BinPartition partition_bins(const size_t *bins, size_t n, size_t num_bins);
+
+// out.bin(b) = values at partition.bin(b), in that order.
+BinTable gather_bins(const uint256_t *values, const BinPartition &partition);
+
+// Stable partition: bin bins[i] receives values[i], in input order.
+BinTable build_bin_table(const uint256_t *values, const size_t *bins, size_t n, size_t num_bins);
+
+// Moves the element of every singleton bin to the end of the next non-empty
+// bin (wrapping around), visiting bins in order. Elements keep their
+// indices, so anything gathered through the result stays attached to them.
+// One backward pass finds the next non-empty bin for every bin, so this is
+// O(n + bins) however sparse the table is.
+BinPartition rebalance_singletons(const BinPartition &bins);
+
+// Concatenates per-bin vectors (e.g. polynomials built in parallel).
+BinTable flatten_bins(const vector<vector<uint256_t>> &bins);
+
+// How the receiver spreads its elements over the bins. The sender only
+// learns the strategy, so it inserts each element into every bin the
+// receiver could have picked for it.
+//   SIMPLE      one hash, unbounded load (the original scheme)
+//   TWO_CHOICE  the less loaded of two bins, max load ~ n/bins + log log n
+//   CUCKOO      two bins of fixed capacity with eviction; the few elements
+//               that find no place go to a stash bin after the regular ones
+enum class BinStrategy { SIMPLE, TWO_CHOICE, CUCKOO };
+
+struct BinConfig {
+    BinStrategy strategy = BinStrategy::SIMPLE;
+    // Pad every bin with dummy points up to the largest load, so polynomial
+    // degrees no longer reveal how many elements each bin holds
+    bool pad = false;
+    // Pad every bin, stash and empty bins included, to one degree that
+    // follows from the public sizes alone (fixed_bin_load). All polynomials
+    // then share a length: they travel as a single message without a bin
+    // directory and are evaluated in lockstep across bins.
+    bool fixed_degree = false;
+};
+
+// Elements the cuckoo stash may hold before the bin capacity is raised.
+const size_t CUCKOO_STASH_SIZE = 8;
+
+// Evictions one insertion may cause before its element goes to the stash.
+const size_t CUCKOO_MAX_KICKS = 500;
+
+inline size_t bin_choices(BinStrategy strategy) {
+    return strategy == BinStrategy::SIMPLE ? 1 : 2;
+}
+
+// Points per bin in fixed-degree mode for n elements over num_bins bins: the
+// average plus a margin that a strategy's largest bin rarely exceeds (a
+// Chernoff bound for simple hashing, log log for two choices, the cuckoo
+// capacity). A party whose largest bin does exceed it pads to that instead.
+size_t fixed_bin_load(size_t n, size_t num_bins, BinStrategy strategy);
+
+// Candidate bin j < bin_choices() of an element. The second candidate is
+// derived from another word of the bin hash and never equals the first.
+size_t candidate_bin(const uint256_t &bin_hash, size_t j, size_t num_bins);
+
+// Per-element digests of one party's input, computed once per session and
+// read by every later phase instead of rehashing.
+struct DigestTable {
+    vector<uint256_t> h1;        // H_1(x_i)
+    vector<uint256_t> bin_hash;  // BLAKE2b(H_1(x_i)), input to H_bin
+    // Filled by assign_bins() once the bin count is known
+    size_t num_bins = 0;         // regular bins; a cuckoo stash is bin num_bins
+    size_t max_load = 0;         // largest regular bin
+    vector<size_t> bins;         // bin of x_i
+    vector<size_t> slots;        // position of x_i within its bin
+    BinPartition partition;      // element indices grouped by bin
+
+    void compute(const uint256_t *input, size_t n);
+    // Places every element using the cached bin hashes; no hashing.
+    void assign_bins(size_t num_bins, BinStrategy strategy = BinStrategy::SIMPLE);
+    size_t size() const { return h1.size(); }
+};
+
+// Sender side: pair p = i * per_element + j stands for element i in its
+// j-th candidate bin (the last one being the stash when with_stash is set).
+// Returns the bin of every pair.
+vector<size_t> candidate_pairs(const DigestTable &digests, size_t num_bins,
+                               BinStrategy strategy, bool with_stash, size_t &per_element);
+
+// Appends random (x, y) points until xs holds target points.
+void pad_with_dummies(vector<uint256_t> &xs, vector<uint256_t> &ys, size_t target);
+
+#endif
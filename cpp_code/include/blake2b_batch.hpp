@@ -0,0 +1,21 @@
+#ifndef BLAKE2B_BATCH_HPP
+#define BLAKE2B_BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "helpers.hpp"
+
+// Multi-buffer BLAKE2b-256 for independent single-block messages.
+//
+// With AVX2 four messages are compressed at once, one per 64-bit lane;
+// otherwise each message goes through crypto_blake2b. Digests are
+// byte-identical to crypto_blake2b(out, 32, msg, msg_len) either way.
+
+// Largest message the batch kernel handles (one BLAKE2b block).
+const size_t BLAKE2B_BLOCK_BYTES = 128;
+
+// out[i] = BLAKE2b-256(in + i * stride, msg_len) for i < n. Messages longer
+// than one block are hashed one at a time.
+void blake2b_256_batch(uint256_t *out, const uint8_t *in, size_t msg_len, size_t stride, size_t n);
+
+#endif
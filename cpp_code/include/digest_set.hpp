@@ -0,0 +1,47 @@
+#ifndef DIGEST_SET_HPP
+#define DIGEST_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "helpers.hpp"
+
+// Open-addressing set of 32-byte digests.
+//
+// Keys live in one contiguous array in insertion order; the table itself only
+// holds a 64-bit fingerprint and a key index per slot, and linear probing
+// compares fingerprints before touching a key. Fingerprints mix the digest
+// words with a per-set random key, so a peer choosing the digests cannot
+// force long probe chains.
+
+class DigestSet {
+public:
+    DigestSet();
+    DigestSet(const uint256_t *keys, size_t n);
+
+    // Makes room for n keys without rehashing.
+    void reserve(size_t n);
+
+    // Returns false if key was already present.
+    bool insert(const uint256_t &key);
+
+    bool contains(const uint256_t &key) const;
+
+    // found[i] = contains(queries[i]), prefetching a few probes ahead.
+    void contains_batch(uint8_t *found, const uint256_t *queries, size_t n) const;
+
+    size_t size() const { return keys.size(); }
+
+private:
+    std::vector<uint256_t> keys;
+    std::vector<uint64_t> fingerprints;  // 0 marks an empty slot
+    std::vector<uint32_t> slot_keys;     // index into keys
+    size_t mask;
+    uint64_t salt[4];
+
+    uint64_t fingerprint(const uint256_t &key) const;
+    size_t find(const uint256_t &key, uint64_t fp) const;
+    void rehash(size_t capacity);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef DRBG_HPP
+#define DRBG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "helpers.hpp"
+
+// Buffered ChaCha20 random generator.
+//
+// Output is the crypto_chacha20_djb keystream, produced a buffer at a time.
+// The first 32 bytes of every refill replace the key (fast key erasure), so
+// a later state compromise does not reveal earlier output.
+//
+// Each thread gets its own generator from local(); all of them derive their
+// keys from one process seed, read once from the OS (getentropy)
+// or fixed with set_seed() for reproducible benchmarks.
+
+// Keystream bytes generated per refill (16 ChaCha20 blocks).
+const size_t DRBG_BUFFER_BYTES = 1024;
+
+class ChaChaDrbg {
+public:
+    explicit ChaChaDrbg(const uint8_t key[32]);
+    ~ChaChaDrbg();
+
+    ChaChaDrbg(const ChaChaDrbg&) = delete;
+    ChaChaDrbg& operator=(const ChaChaDrbg&) = delete;
+
+    void fill(uint8_t *out, size_t len);
+    void fill(uint256_t *out, size_t n) {
+        if (n != 0) fill(out->bytes, n * sizeof(uint256_t));
+    }
+
+    // The calling thread's generator, created on first use.
+    static ChaChaDrbg &local();
+
+    // Derives every generator from seed instead of OS entropy. Must be called
+    // before the first local(); only meant for benchmarks and tests.
+    static void set_seed(uint64_t seed);
+
+private:
+    uint8_t key[32];
+    uint8_t buffer[DRBG_BUFFER_BYTES];
+    size_t used;
+
+    void refill();
+};
+
+#endif
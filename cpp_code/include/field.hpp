@@ -0,0 +1,217 @@
+#ifndef FIELD_HPP
+#define FIELD_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "helpers.hpp"
+
+// Arithmetic in GF(p), p = 2^255 - 19, on fixed 4x64-bit limbs.
+//
+// Limbs are little-endian and kept below 2^256, so a value may carry one
+// redundant multiple of p. Every operation accepts such inputs; only
+// fe_to_bytes() and fe_canonical() produce the unique representative in
+// [0, p). Single-element operations never allocate.
+
+typedef unsigned __int128 fe_u128;
+
+struct fe25519 {
+    uint64_t v[4];
+};
+
+inline fe25519 fe_zero() { return fe25519{{0, 0, 0, 0}}; }
+inline fe25519 fe_one()  { return fe25519{{1, 0, 0, 0}}; }
+inline fe25519 fe_from_u64(uint64_t x) { return fe25519{{x, 0, 0, 0}}; }
+
+// Folds a carry out of bit 256 back in using 2^256 = 38 (mod p). The carry
+// must stay below 2^32 (fe_mul_small's is the largest).
+inline void fe_fold_carry(uint64_t r[4], uint64_t carry) {
+    fe_u128 c = (fe_u128)r[0] + (fe_u128)carry * 38;
+    r[0] = (uint64_t)c; c >>= 64;
+    c += r[1]; r[1] = (uint64_t)c; c >>= 64;
+    c += r[2]; r[2] = (uint64_t)c; c >>= 64;
+    c += r[3]; r[3] = (uint64_t)c; c >>= 64;
+    // A second carry leaves r[0] tiny, so this cannot overflow.
+    r[0] += (uint64_t)c * 38;
+}
+
+inline void fe_add(fe25519 &h, const fe25519 &f, const fe25519 &g) {
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (fe_u128)f.v[i] + g.v[i];
+        h.v[i] = (uint64_t)c;
+        c >>= 64;
+    }
+    fe_fold_carry(h.v, (uint64_t)c);
+}
+
+inline void fe_sub(fe25519 &h, const fe25519 &f, const fe25519 &g) {
+    uint64_t borrow = 0;
+    for (int i = 0; i < 4; i++) {
+        fe_u128 d = (fe_u128)f.v[i] - g.v[i] - borrow;
+        h.v[i] = (uint64_t)d;
+        borrow = (uint64_t)(d >> 64) & 1;
+    }
+    // A borrow means we computed f - g + 2^256; remove 2^256 = 38 (mod p),
+    // twice if the first correction borrows again.
+    for (int round = 0; round < 2; round++) {
+        uint64_t sub = (0 - borrow) & 38;
+        borrow = 0;
+        for (int i = 0; i < 4; i++) {
+            fe_u128 d = (fe_u128)h.v[i] - (i == 0 ? sub : 0) - borrow;
+            h.v[i] = (uint64_t)d;
+            borrow = (uint64_t)(d >> 64) & 1;
+        }
+    }
+}
+
+inline void fe_neg(fe25519 &h, const fe25519 &f) {
+    fe_sub(h, fe_zero(), f);
+}
+
+// Reduces a 512-bit product t[0..7] into h using 2^256 = 38 (mod p).
+inline void fe_reduce_wide(fe25519 &h, const uint64_t t[8]) {
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (fe_u128)t[i + 4] * 38 + t[i];
+        h.v[i] = (uint64_t)c;
+        c >>= 64;
+    }
+    fe_fold_carry(h.v, (uint64_t)c);
+}
+
+// t = f * g, the full 512-bit product.
+inline void fe_mul_wide(uint64_t t[8], const fe25519 &f, const fe25519 &g) {
+    for (int k = 0; k < 8; k++) t[k] = 0;
+    for (int i = 0; i < 4; i++) {
+        fe_u128 c = 0;
+        for (int j = 0; j < 4; j++) {
+            c += (fe_u128)f.v[i] * g.v[j] + t[i + j];
+            t[i + j] = (uint64_t)c;
+            c >>= 64;
+        }
+        t[i + 4] = (uint64_t)c;
+    }
+}
+
+inline void fe_mul(fe25519 &h, const fe25519 &f, const fe25519 &g) {
+    uint64_t t[8];
+    fe_mul_wide(t, f, g);
+    fe_reduce_wide(h, t);
+}
+
+// h = f * g + a with a single reduction: a rides along the carry chain that
+// folds the high half of the product (t[i + 4] * 38 + t[i] + a[i] < 2^71),
+// so a Horner step needs no separate fe_add and its carry fold.
+inline void fe_mul_add(fe25519 &h, const fe25519 &f, const fe25519 &g, const fe25519 &a) {
+    uint64_t t[8];
+    fe_mul_wide(t, f, g);
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (fe_u128)t[i + 4] * 38 + t[i] + a.v[i];
+        h.v[i] = (uint64_t)c;
+        c >>= 64;
+    }
+    fe_fold_carry(h.v, (uint64_t)c);
+}
+
+inline void fe_sq(fe25519 &h, const fe25519 &f) {
+    uint64_t t[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    // Off-diagonal products once, then doubled.
+    for (int i = 0; i < 3; i++) {
+        fe_u128 c = 0;
+        for (int j = i + 1; j < 4; j++) {
+            c += (fe_u128)f.v[i] * f.v[j] + t[i + j];
+            t[i + j] = (uint64_t)c;
+            c >>= 64;
+        }
+        t[i + 4] = (uint64_t)c;
+    }
+    t[7] = t[6] >> 63;
+    for (int k = 6; k > 0; k--) {
+        t[k] = (t[k] << 1) | (t[k - 1] >> 63);
+    }
+    t[0] = 0;
+    // Diagonal squares.
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        fe_u128 sq = (fe_u128)f.v[i] * f.v[i];
+        c += (fe_u128)t[2 * i] + (uint64_t)sq;
+        t[2 * i] = (uint64_t)c; c >>= 64;
+        c += (fe_u128)t[2 * i + 1] + (uint64_t)(sq >> 64);
+        t[2 * i + 1] = (uint64_t)c; c >>= 64;
+    }
+    fe_reduce_wide(h, t);
+}
+
+// h = f * small, for small < 2^32.
+inline void fe_mul_small(fe25519 &h, const fe25519 &f, uint32_t small) {
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (fe_u128)f.v[i] * small;
+        h.v[i] = (uint64_t)c;
+        c >>= 64;
+    }
+    fe_fold_carry(h.v, (uint64_t)c);
+}
+
+// h = f * small + a for any 64-bit small: a Horner step at an integer point,
+// a quarter of the limb products of fe_mul_add. The carry out of bit 256 can
+// reach 2^64, too large for fe_fold_carry, so its 70-bit multiple of 38 is
+// folded into the two low limbs first; what carries out of that is at most 1.
+inline void fe_mul_small_add(fe25519 &h, const fe25519 &f, uint64_t small, const fe25519 &a) {
+    fe_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (fe_u128)f.v[i] * small + a.v[i];
+        h.v[i] = (uint64_t)c;
+        c >>= 64;
+    }
+    fe_u128 fold = (fe_u128)(uint64_t)c * 38;
+    c = (fe_u128)h.v[0] + (uint64_t)fold;
+    h.v[0] = (uint64_t)c; c >>= 64;
+    c += (fe_u128)h.v[1] + (uint64_t)(fold >> 64);
+    h.v[1] = (uint64_t)c; c >>= 64;
+    c += h.v[2]; h.v[2] = (uint64_t)c; c >>= 64;
+    c += h.v[3]; h.v[3] = (uint64_t)c; c >>= 64;
+    fe_fold_carry(h.v, (uint64_t)c);
+}
+
+// Swaps f and g if bit is 1, in constant time.
+inline void fe_cswap(fe25519 &f, fe25519 &g, uint64_t bit) {
+    uint64_t mask = 0 - bit;
+    for (int i = 0; i < 4; i++) {
+        uint64_t x = (f.v[i] ^ g.v[i]) & mask;
+        f.v[i] ^= x;
+        g.v[i] ^= x;
+    }
+}
+
+// Squares f n times in a row.
+inline void fe_sqn(fe25519 &h, const fe25519 &f, int n) {
+    fe_sq(h, f);
+    for (int i = 1; i < n; i++) fe_sq(h, h);
+}
+
+// Reduces f to its unique representative in [0, p).
+void fe_canonical(fe25519 &h, const fe25519 &f);
+
+// h = f^(p-2); maps 0 to 0.
+void fe_invert(fe25519 &h, const fe25519 &f);
+
+// out[i] = in[i]^-1 for all i with one inversion (Montgomery's trick).
+// Like fe_invert, zero maps to zero; out may alias in.
+void fe_batch_invert(fe25519 *out, const fe25519 *in, size_t n);
+
+// h = f^e for a 256-bit little-endian exponent e.
+void fe_pow(fe25519 &h, const fe25519 &f, const uint64_t e[4]);
+
+bool fe_is_zero(const fe25519 &f);
+bool fe_equal(const fe25519 &f, const fe25519 &g);
+
+// Loads all 256 bits (the value is taken mod p, as bytes_to_ZZ % p did).
+fe25519 fe_from_bytes(const uint8_t bytes[32]);
+inline fe25519 fe_from_bytes(const uint256_t &x) { return fe_from_bytes(x.bytes); }
+
+// Canonical little-endian encoding of f mod p.
+uint256_t fe_to_bytes(const fe25519 &f);
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef FIELD_AVX2_HPP
+#define FIELD_AVX2_HPP
+
+// Four GF(2^255 - 19) elements in limb-sliced form for AVX2 kernels.
+//
+// Each element is split into ten limbs of alternately 26 and 25 bits
+// (radix 2^25.5, as in ref10). Register l[k] holds limb k of all four
+// elements, one per 64-bit lane, so _mm256_mul_epu32 computes four 26x26-bit
+// limb products at once. Every function here is compiled for AVX2 only and
+// must only be called after a runtime CPU check (see field_batch_avx2()).
+
+#include <cstdint>
+#include <cstddef>
+#include "field.hpp"
+#include "field_batch.hpp"
+
+// Bit offset of limb k within the 255-bit value.
+static const int FE10_OFFSET[10] = {0, 26, 51, 77, 102, 128, 153, 179, 204, 230};
+
+// Splits f (any representative) into ten tight limbs of its canonical value.
+inline void fe_to_limbs10(uint64_t out[10], const fe25519 &f) {
+    fe25519 t;
+    fe_canonical(t, f);
+    for (int k = 0; k < 10; k++) {
+        int off = FE10_OFFSET[k];
+        int width = (k & 1) ? 25 : 26;
+        int word = off / 64, sh = off % 64;
+        fe_u128 bits = t.v[word];
+        if (word < 3) bits |= (fe_u128)t.v[word + 1] << 64;
+        out[k] = (uint64_t)(bits >> sh) & ((1ULL << width) - 1);
+    }
+}
+
+// Reassembles ten limbs (each a little above its width at most) into f.
+inline void fe_from_limbs10(fe25519 &f, const uint64_t in[10]) {
+    uint64_t r[5] = {0, 0, 0, 0, 0};
+    for (int k = 0; k < 10; k++) {
+        int word = FE10_OFFSET[k] / 64, sh = FE10_OFFSET[k] % 64;
+        fe_u128 c = (fe_u128)in[k] << sh;
+        for (int w = word; w < 5 && c != 0; w++) {
+            c += r[w];
+            r[w] = (uint64_t)c;
+            c >>= 64;
+        }
+    }
+    f.v[0] = r[0]; f.v[1] = r[1]; f.v[2] = r[2]; f.v[3] = r[3];
+    fe_fold_carry(f.v, r[4]);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define APSI_HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+
+#define APSI_AVX2 __attribute__((target("avx2")))
+
+struct fe25519x4 {
+    __m256i l[10];
+};
+
+APSI_AVX2 static inline __m256i fe4_mul19(__m256i c) {
+    return _mm256_add_epi64(c, _mm256_add_epi64(_mm256_slli_epi64(c, 1),
+                                                 _mm256_slli_epi64(c, 4)));
+}
+
+// Carries limb k into limb k + 1 (limb 9 wraps into limb 0 times 19).
+APSI_AVX2 static inline void fe4_carry_step(fe25519x4 &h, int k) {
+    __m256i c;
+    if (k & 1) {
+        c = _mm256_srli_epi64(h.l[k], 25);
+        h.l[k] = _mm256_and_si256(h.l[k], _mm256_set1_epi64x((1LL << 25) - 1));
+    } else {
+        c = _mm256_srli_epi64(h.l[k], 26);
+        h.l[k] = _mm256_and_si256(h.l[k], _mm256_set1_epi64x((1LL << 26) - 1));
+    }
+    if (k < 9) {
+        h.l[k + 1] = _mm256_add_epi64(h.l[k + 1], c);
+    } else {
+        h.l[0] = _mm256_add_epi64(h.l[0], fe4_mul19(c));
+    }
+}
+
+// Brings every limb back to its width (limbs 1 and 5 may keep a few extra
+// bits). Two interleaved chains, as in ref10, halve the dependency depth.
+APSI_AVX2 static inline void fe4_carry(fe25519x4 &h) {
+    fe4_carry_step(h, 0); fe4_carry_step(h, 4);
+    fe4_carry_step(h, 1); fe4_carry_step(h, 5);
+    fe4_carry_step(h, 2); fe4_carry_step(h, 6);
+    fe4_carry_step(h, 3); fe4_carry_step(h, 7);
+    fe4_carry_step(h, 4); fe4_carry_step(h, 8);
+    fe4_carry_step(h, 9);
+    fe4_carry_step(h, 0);
+}
+
+APSI_AVX2 static inline void fe4_add(fe25519x4 &h, const fe25519x4 &f, const fe25519x4 &g) {
+    for (int k = 0; k < 10; k++) {
+        h.l[k] = _mm256_add_epi64(f.l[k], g.l[k]);
+    }
+    fe4_carry(h);
+}
+
+// h = f - g, computed as f + 2p - g so no lane goes negative.
+APSI_AVX2 static inline void fe4_sub(fe25519x4 &h, const fe25519x4 &f, const fe25519x4 &g) {
+    const __m256i two_p0 = _mm256_set1_epi64x(0x7ffffdaLL);
+    const __m256i two_p_even = _mm256_set1_epi64x(0x7fffffeLL);
+    const __m256i two_p_odd = _mm256_set1_epi64x(0x3fffffeLL);
+    for (int k = 0; k < 10; k++) {
+        __m256i bias = k == 0 ? two_p0 : ((k & 1) ? two_p_odd : two_p_even);
+        h.l[k] = _mm256_sub_epi64(_mm256_add_epi64(f.l[k], bias), g.l[k]);
+    }
+    fe4_carry(h);
+}
+
+// Limbs of f and g must be below 2^27.
+APSI_AVX2 static inline void fe4_mul(fe25519x4 &h, const fe25519x4 &f, const fe25519x4 &g) {
+    const __m256i nineteen = _mm256_set1_epi64x(19);
+    __m256i g19[10], f2[10], t[10];
+    for (int k = 0; k < 10; k++) {
+        g19[k] = _mm256_mul_epu32(g.l[k], nineteen);
+        f2[k] = (k & 1) ? _mm256_add_epi64(f.l[k], f.l[k]) : f.l[k];
+        t[k] = _mm256_setzero_si256();
+    }
+    // Products wrapping past limb 9 pick up 2^255 = 19; odd x odd limb
+    // products pick up a factor 2 from the half-bit radix.
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            __m256i a = ((i & 1) && (j & 1)) ? f2[i] : f.l[i];
+            __m256i b = (i + j >= 10) ? g19[j] : g.l[j];
+            int k = (i + j) % 10;
+            t[k] = _mm256_add_epi64(t[k], _mm256_mul_epu32(a, b));
+        }
+    }
+    for (int k = 0; k < 10; k++) h.l[k] = t[k];
+    fe4_carry(h);
+}
+
+APSI_AVX2 static inline void fe4_sq(fe25519x4 &h, const fe25519x4 &f) {
+    fe4_mul(h, f, f);
+}
+
+// h = f * c for a small constant c < 2^31.
+APSI_AVX2 static inline void fe4_mul_small(fe25519x4 &h, const fe25519x4 &f, uint32_t c) {
+    const __m256i cc = _mm256_set1_epi64x(c);
+    for (int k = 0; k < 10; k++) {
+        h.l[k] = _mm256_mul_epu32(f.l[k], cc);
+    }
+    fe4_carry(h);
+}
+
+// Swaps f and g in the lanes where mask is all ones.
+APSI_AVX2 static inline void fe4_cswap(fe25519x4 &f, fe25519x4 &g, __m256i mask) {
+    for (int k = 0; k < 10; k++) {
+        __m256i x = _mm256_and_si256(_mm256_xor_si256(f.l[k], g.l[k]), mask);
+        f.l[k] = _mm256_xor_si256(f.l[k], x);
+        g.l[k] = _mm256_xor_si256(g.l[k], x);
+    }
+}
+
+// Every lane set to the same (already split) constant.
+APSI_AVX2 static inline void fe4_broadcast(fe25519x4 &h, const uint64_t limbs[10]) {
+    for (int k = 0; k < 10; k++) {
+        h.l[k] = _mm256_set1_epi64x((long long)limbs[k]);
+    }
+}
+
+// Loads up to four elements; missing lanes are zero.
+APSI_AVX2 static inline void fe4_load(fe25519x4 &h, const fe25519 *in, size_t count) {
+    alignas(32) uint64_t lanes[10][4] = {};
+    for (size_t lane = 0; lane < count && lane < 4; lane++) {
+        uint64_t limbs[10];
+        fe_to_limbs10(limbs, in[lane]);
+        for (int k = 0; k < 10; k++) lanes[k][lane] = limbs[k];
+    }
+    for (int k = 0; k < 10; k++) {
+        h.l[k] = _mm256_load_si256((const __m256i *)lanes[k]);
+    }
+}
+
+// Group g of a FieldBatch is already limb-sliced, so a load is one aligned
+// access per limb.
+APSI_AVX2 static inline void fe4_load_group(fe25519x4 &h, const fe_limbs4 &g) {
+    for (int k = 0; k < 10; k++) {
+        h.l[k] = _mm256_load_si256((const __m256i *)g.l[k]);
+    }
+}
+
+APSI_AVX2 static inline void fe4_store(fe25519 *out, const fe25519x4 &f, size_t count) {
+    alignas(32) uint64_t lanes[10][4];
+    for (int k = 0; k < 10; k++) {
+        _mm256_store_si256((__m256i *)lanes[k], f.l[k]);
+    }
+    for (size_t lane = 0; lane < count && lane < 4; lane++) {
+        uint64_t limbs[10];
+        for (int k = 0; k < 10; k++) limbs[k] = lanes[k][lane];
+        fe_from_limbs10(out[lane], limbs);
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef FIELD_BATCH_HPP
+#define FIELD_BATCH_HPP
+
+#include <cstddef>
+#include <vector>
+#include "field.hpp"
+
+// Batch field operations over many independent elements. On x86 CPUs with
+// AVX2 they run four elements at a time in limb-sliced registers
+// (field_avx2.hpp); everywhere else they fall back to the scalar fe_* code.
+// The choice is made once at runtime from CPUID.
+
+// True if the AVX2 kernels are compiled in and supported by this CPU.
+bool field_batch_avx2();
+
+// Four elements in limb-sliced form: l[k][lane] is limb k of one element,
+// ten limbs of alternately 26 and 25 bits (the fe25519x4 register layout).
+struct alignas(32) fe_limbs4 {
+    uint64_t l[10][4];
+};
+
+// A batch of field elements stored structure-of-arrays: element i is lane
+// i % 4 of group i / 4. Groups are 32-byte aligned, so the AVX2 kernels move
+// each limb row with one aligned access and never transpose. Limbs are
+// carried (at most a little above their width); lanes past size() are zero.
+//
+// Byte and fe25519 arrays convert in one pass; kernels that chain (the
+// polynomial evaluation feeding X25519) pass the batch on unconverted.
+class FieldBatch {
+public:
+    FieldBatch() : count(0) {}
+    explicit FieldBatch(size_t n) : count(n), groups((n + 3) / 4, fe_limbs4()) {}
+
+    size_t size() const { return count; }
+    size_t num_groups() const { return groups.size(); }
+    fe_limbs4 &group(size_t g) { return groups[g]; }
+    const fe_limbs4 &group(size_t g) const { return groups[g]; }
+
+    fe25519 get(size_t i) const;
+    void set(size_t i, const fe25519 &f);
+
+    // Bytes are read as all 256 bits mod p, as fe_from_bytes() does.
+    static FieldBatch from_bytes(const uint256_t *in, size_t n);
+    static FieldBatch from_fe(const fe25519 *in, size_t n);
+    // Canonical encodings, as fe_to_bytes().
+    void to_bytes(uint256_t *out) const;
+    vector<uint256_t> to_bytes() const;
+    void to_fe(fe25519 *out) const;
+
+private:
+    size_t count;
+    std::vector<fe_limbs4> groups;
+};
+
+// out[i] = a[i] * b[i] for i < n; out may alias a or b.
+void fe_mul_batch(fe25519 *out, const fe25519 *a, const fe25519 *b, size_t n);
+
+// out[i] = a[i]^2 for i < n; out may alias a.
+void fe_sq_batch(fe25519 *out, const fe25519 *a, size_t n);
+
+// Polynomials with up to this many coefficients are evaluated by kernels
+// specialized for their exact length (bin degrees cluster around log2 n);
+// longer ones take the generic Horner loop.
+const size_t POLY_EVAL_SPECIALIZED_MAX = 32;
+
+// out[i] = f(points[i]), f given by ncoeffs coefficients (lowest degree
+// first); out may alias points. Horner's rule; specialized lengths are
+// picked from a jump table.
+void fe_poly_eval_batch(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                        const fe25519 *points, size_t n);
+
+// out[i] = f_{which[i]}(points[i]), where every f_j has ncoeffs coefficients
+// at coeffs + j * ncoeffs. Since all of them share one degree, four points of
+// different polynomials run Horner in lockstep with no per-lane branching.
+void fe_poly_eval_lockstep(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                           const size_t *which, const fe25519 *points, size_t n);
+
+// out[j] = f(first + j) for j < n: f over the arithmetic progression of
+// integers starting at first. Horner with a word-sized multiplier, so each
+// step costs one row of limb products instead of a full field multiply.
+void fe_poly_eval_progression(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                              uint64_t first, size_t n);
+
+#endif
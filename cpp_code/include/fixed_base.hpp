@@ -0,0 +1,54 @@
+#ifndef FIXED_BASE_HPP
+#define FIXED_BASE_HPP
+
+#include <vector>
+#include <cstddef>
+#include "helpers.hpp"
+#include "field.hpp"
+#include "x25519_batch.hpp"
+
+// Fixed-base X25519 through precomputed comb tables.
+//
+// X25519 itself only sees u-coordinates, which cannot be added without a
+// known difference. The table therefore lifts the base point to the
+// birationally equivalent Edwards curve once and stores j * 16^i * P for
+// i < 64, j = 1..8. A scalar multiplication is then 64 table additions
+// (signed radix-16 digits, constant-time selection) and no doublings; the
+// result maps back to u = (1 + y) / (1 - y). Outputs are byte-identical to
+// crypto_x25519(out, scalar, base).
+
+// Affine table entry: (y + x, y - x, 2 * d * x * y).
+struct ge_niels {
+    fe25519 ypx, ymx, xy2d;
+};
+
+class FixedBaseTable {
+public:
+    static const size_t WINDOWS = 64;
+    static const size_t ENTRIES = 8;
+
+    // Builds the table for the point with u-coordinate base (bit 255 is
+    // ignored, as in crypto_x25519). If base is not on curve25519 (e.g. it
+    // lies on the twist) the table stays empty and valid() is false.
+    explicit FixedBaseTable(const uint256_t &base);
+
+    bool valid() const { return !table.empty(); }
+
+    // out[i] = X25519(scalars[i], base), sharing one inversion per batch.
+    // Must only be called on a valid() table.
+    void scalarmult_batch(uint256_t *out, const uint256_t *scalars, size_t n,
+                          size_t batch_size = X25519_BATCH_SIZE) const;
+
+    // Table for the X25519 generator u = 9, built once on first use.
+    static const FixedBaseTable &generator();
+
+private:
+    std::vector<ge_niels> table;  // table[i * ENTRIES + j - 1] = j * 16^i * P
+};
+
+// out[i] = X25519(scalars[i], point) through a table built for point when
+// it is on the curve, and through x25519_batch() otherwise.
+void x25519_fixed_base_batch(uint256_t *out, const uint256_t *scalars, const uint256_t &point,
+                             size_t n, size_t batch_size = X25519_BATCH_SIZE);
+
+#endif
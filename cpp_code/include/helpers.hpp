@@ -5,30 +5,36 @@
 #include <iomanip>
 #include <cstring>
 #include <random>
-#include <NTL/ZZ_p.h>
-#include <NTL/ZZ_pX.h>
 #include <vector>
 #include "monocypher.hpp"
+#ifdef APSI_USE_NTL
+#include <NTL/ZZ_p.h>
+#include <NTL/ZZ_pX.h>
+#endif
 
 using namespace std;
+#ifdef APSI_USE_NTL
 using namespace NTL;
+#endif
 
 // Array of 32 elements of 8 bits each
 struct uint256_t {
     uint8_t bytes[32];
 };
 
+// Bins in offset-array form, see bin_table.hpp
+struct BinTable;
+
 // Function to generate randomness and Elligator messages
 // Input: number of KA messages to generate.
 pair<vector<uint256_t>, vector<uint256_t>> gen_elligator_messages(size_t num_messages);
 
 size_t H_bin(const uint8_t hash[32], size_t bin_size);
 
-uint256_t H_2(const uint256_t& x_i, const uint256_t& k_i);
-
-ZZ bytes_to_ZZ(const uint256_t& num); 
+// out[i] = H_bin(hashes[i].bytes, bin_size) for i < n.
+void H_bin_batch(size_t* out, const uint256_t* hashes, size_t n, size_t bin_size);
 
-uint256_t ZZ_to_bytes(const ZZ& num); 
+uint256_t H_2(const uint256_t& x_i, const uint256_t& k_i);
 
 vector<uint256_t> Lagrange_Polynomial(vector<uint256_t> inputs, const vector<uint256_t> evaluations);
 
@@ -40,16 +46,47 @@ uint256_t combine_hashes(const uint256_t& left, const uint256_t& right);
 
 uint256_t bytes_to_field(const uint8_t* bytes); 
 
-uint256_t Merkle_Root_Receiver(vector<vector<uint256_t>> merkle_leaves, size_t n);
+// Points the receiver's polynomials are evaluated at for its commitment;
+// polynomial i takes the next bin_size(i) points of the domain.
+//   ROOTS_OF_UNITY  powers of 3^((p-1)/n) (the original domain)
+//   PROGRESSION     the integers 1 .. n: no exponentiation or power table,
+//                   and every Horner step multiplies by a single word
+enum class CommitDomain { ROOTS_OF_UNITY, PROGRESSION };
+
+// Merkle roots of the two commitments; arity as in merkle.hpp.
+uint256_t Merkle_Root_Receiver(const BinTable& polys, size_t n, size_t arity = 2,
+                               CommitDomain domain = CommitDomain::ROOTS_OF_UNITY);
 
 // Compute the Merkle root after appending input values with the ideal permutation of the random values
-uint256_t Merkle_Root_Sender(vector<uint256_t> merkle_leaves);
+uint256_t Merkle_Root_Sender(const vector<uint256_t>& merkle_leaves, size_t arity = 2);
 
 uint256_t evaluate_poly(const vector<uint256_t>& poly, const uint8_t* point_bytes); 
 
 uint256_t H_1(const uint256_t& x);
 uint256_t concatenate_and_hash(const uint256_t& a, const uint256_t& b);
 
+// Batch versions of the hashes above (multi-buffer BLAKE2b); out[i] equals
+// the single call on element i and may alias an input.
+void H_1_batch(uint256_t* out, const uint256_t* x, size_t n);
+void H_2_batch(uint256_t* out, const uint256_t* x, const uint256_t* k, size_t n);
+void concatenate_and_hash_batch(uint256_t* out, const uint256_t* a, const uint256_t* b, size_t n);
+
+// One level of a binary Merkle tree: H_2 over adjacent pairs, with an odd
+// last node hashed with itself. The roots above come from merkle.hpp; this
+// allocating form is kept as the plain reference.
+vector<uint256_t> Merkle_Next_Level(const vector<uint256_t>& level);
+
+#ifdef APSI_USE_NTL
+// NTL reference backend, kept only to cross-check the native field code.
+ZZ bytes_to_ZZ(const uint256_t& num); 
+
+uint256_t ZZ_to_bytes(const ZZ& num); 
+
+vector<uint256_t> Lagrange_Polynomial_NTL(const vector<uint256_t>& inputs, const vector<uint256_t>& evaluations);
+
+uint256_t evaluate_poly_NTL(const vector<uint256_t>& poly, const uint8_t* point_bytes);
+#endif
+
 inline bool operator==(const uint256_t& a, const uint256_t& b) {
     return memcmp(a.bytes, b.bytes, 32) == 0;
 }
@@ -57,13 +94,12 @@ inline bool operator==(const uint256_t& a, const uint256_t& b) {
 namespace std {
     template <>
     struct hash<uint256_t> {
+        // Values are already uniform digests, so folding their words is
+        // enough; containers facing chosen digests should use DigestSet.
         size_t operator()(const uint256_t& k) const {
-            uint8_t digest[32];
-            // TODO: check if this can be optimized
-            crypto_blake2b(digest, sizeof(digest), k.bytes, 32);
-            size_t h;
-            memcpy(&h, digest, sizeof(h));
-            return h;
+            uint64_t w[4];
+            memcpy(w, k.bytes, sizeof(w));
+            return (size_t)(w[0] ^ w[1] ^ w[2] ^ w[3]);
         }
     };
 }
@@ -0,0 +1,112 @@
+#ifndef MERKLE_HPP
+#define MERKLE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "helpers.hpp"
+
+// Merkle trees over 32-byte leaves, binary by default or 4-/8-ary.
+//
+// A node is BLAKE2b-256 of its children back to back, so a binary node is
+// H_2(left, right) and a 4-ary node fills exactly one BLAKE2b block. A level
+// whose node count is not a multiple of the arity pads its last group with
+// copies of its last node (binary: the last node is hashed with itself), and
+// a single leaf is its own root. The tree is reduced in
+// blocks of MERKLE_BLOCK_LEAVES aligned leaves: every block collapses to its
+// subtree root on one thread while it stays in cache, each level a single
+// multi-buffer hashing pass, and the block roots are joined at the end.
+
+// Leaves per block (a power of 2, 4 and 8); 4096 leaves are 128 KB and fit
+// in L2 together with the next level.
+const size_t MERKLE_BLOCK_LEAVES = 4096;
+
+// Throws unless arity is 2, 4 or 8.
+void check_merkle_arity(size_t arity);
+
+// Root of the tree over leaves[0 .. n); all zero for n = 0.
+uint256_t merkle_root(const uint256_t *leaves, size_t n, size_t arity = 2);
+
+// Same root, using leaves as the working buffer: no allocation beyond the
+// block roots, and leaves is overwritten.
+uint256_t merkle_root_in_place(uint256_t *leaves, size_t n, size_t arity = 2);
+
+// Merkle root over leaves that arrive over time, in O(log n) memory. The
+// frontier holds the pending subtree roots of every level, one per unit of
+// that digit of the leaf count (one per set bit when binary); root() closes
+// it with the padding rule, so it equals merkle_root() over all leaves added
+// so far and can be taken at any point.
+class MerkleAccumulator {
+public:
+    explicit MerkleAccumulator(size_t arity = 2);
+
+    void add(const uint256_t &leaf);
+    // Whole aligned blocks in the batch are reduced in parallel first.
+    void add(const uint256_t *leaves, size_t n);
+
+    uint256_t root() const;
+    size_t size() const { return count; }
+
+private:
+    size_t arity;
+    size_t count;
+    std::vector<uint256_t> frontier;  // arity slots per level
+
+    // Adds the root of arity^level leaves; count must be a multiple of it.
+    void push(uint256_t node, size_t level);
+};
+
+// Every level of a tree in one flat array, leaves first and root last, so
+// any node is one offset away and the whole tree can be written to disk and
+// mapped back read-only. The file is a 32-byte header (magic, leaf count,
+// arity) followed by the nodes in host byte order.
+class MerkleTree {
+public:
+    MerkleTree();
+    // Builds all levels, block by block as merkle_root() does.
+    MerkleTree(const uint256_t *leaves, size_t n, size_t arity = 2);
+    ~MerkleTree();
+
+    MerkleTree(MerkleTree &&other);
+    MerkleTree &operator=(MerkleTree &&other);
+    MerkleTree(const MerkleTree &) = delete;
+    MerkleTree &operator=(const MerkleTree &) = delete;
+
+    void save(const std::string &path) const;
+    // Maps a saved tree instead of reading it; nothing is rehashed.
+    static MerkleTree load(const std::string &path);
+
+    size_t size() const { return n; }
+    size_t arity() const { return k; }
+    size_t num_levels() const { return level_offsets.size() - 1; }
+    const uint256_t *level(size_t l) const { return nodes + level_offsets[l]; }
+    size_t level_size(size_t l) const { return level_offsets[l + 1] - level_offsets[l]; }
+    const uint256_t *leaves() const { return nodes; }
+    uint256_t root() const;
+
+    // Inclusion proof of leaf index: per level below the root, the group of
+    // arity siblings with the path node left out, padding copies included.
+    size_t proof_length() const { return (num_levels() - 1) * (k - 1); }
+    void prove(uint256_t *out, size_t index) const;
+    // Proofs of several leaves, back to back.
+    vector<uint256_t> prove(const size_t *indices, size_t count) const;
+
+private:
+    size_t n;
+    size_t k;
+    vector<size_t> level_offsets;  // level l is nodes[level_offsets[l] .. level_offsets[l + 1])
+    vector<uint256_t> owned;       // storage of a built tree
+    const uint256_t *nodes;        // owned.data() or the mapping
+    void *mapping;
+    size_t mapping_bytes;
+
+    void set_layout(size_t n, size_t arity);
+    void release();
+};
+
+// Checks a proof from MerkleTree::prove() for leaf index of a tree over n
+// leaves against root.
+bool merkle_verify(const uint256_t &root, const uint256_t &leaf, size_t index,
+                   size_t n, size_t arity, const uint256_t *proof);
+
+#endif
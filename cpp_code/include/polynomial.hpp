@@ -0,0 +1,75 @@
+#ifndef POLYNOMIAL_HPP
+#define POLYNOMIAL_HPP
+
+#include <vector>
+#include <cstddef>
+#include "helpers.hpp"
+#include "field.hpp"
+
+// Polynomial over GF(2^255 - 19) with coefficients already decoded into
+// field elements ("prepared"), lowest degree first.
+typedef vector<fe25519> fe_poly;
+
+// Below this many points multipoint_eval() runs Horner per point; above it
+// the subproduct tree pays for itself.
+const size_t MULTIPOINT_TREE_THRESHOLD = 64;
+
+// Interpolation switches from the quadratic Lagrange formula to the
+// subproduct-tree algorithm at this many points.
+const size_t INTERPOLATE_TREE_THRESHOLD = 128;
+
+// poly_mul() falls back to schoolbook multiplication below this many
+// coefficients per operand.
+const size_t KARATSUBA_THRESHOLD = 32;
+
+// poly_rem_monic() uses schoolbook long division while the quotient or the
+// modulus has fewer coefficients than this.
+const size_t NEWTON_DIVISION_THRESHOLD = 64;
+
+// Decodes wire-format coefficients once so they can be reused for many points.
+fe_poly prepare_poly(const vector<uint256_t>& coeffs);
+fe_poly prepare_poly(const uint256_t* coeffs, size_t n);
+
+// h = f * g
+void poly_mul(fe_poly& h, const fe_poly& f, const fe_poly& g);
+
+// h = f' (formal derivative)
+void poly_derivative(fe_poly& h, const fe_poly& f);
+
+// r = f mod m, for monic m. Large divisions multiply by the power-series
+// inverse of the reversed modulus (Newton iteration), so they cost a few
+// products, O(M(d)), instead of Theta(deg f * deg m).
+void poly_rem_monic(fe_poly& r, const fe_poly& f, const fe_poly& m);
+
+// Horner evaluation of a prepared polynomial at one point.
+fe25519 poly_eval(const fe_poly& f, const fe25519& x);
+
+// Products of (x - x_i) over a binary tree of the points; levels[0] holds the
+// linear leaves and levels.back()[0] the full product. An odd node at the end
+// of a level is carried up unchanged.
+struct SubproductTree {
+    vector<vector<fe_poly>> levels;
+    size_t num_points;
+
+    SubproductTree(const fe25519* points, size_t n);
+    const fe_poly& root() const { return levels.back()[0]; }
+};
+
+// out[i] = f(points[i]) for i < n.
+//
+// Tree evaluation and interpolation cost O(M(d) log d), M(d) being the cost
+// of a product of degree d. GF(2^255 - 19) has no large power-of-two roots
+// of unity for an FFT, so products are Karatsuba, M(d) = O(d^1.59): the tree
+// paths are O(d^1.59 log d), not the O(d log^2 d) of FFT-based arithmetic.
+void multipoint_eval(fe25519* out, const fe_poly& f, const fe25519* points, size_t n);
+
+// out[i] = f(points[i]), descending the remainders of f through a prebuilt tree.
+void multipoint_eval(fe25519* out, const fe_poly& f, const SubproductTree& tree,
+                     const fe25519* points);
+
+// P = the unique polynomial of degree < n with P(xs[i]) = ys[i].
+// The xs must be pairwise distinct; P has exactly n coefficients
+// (leading ones may be zero).
+void interpolate(fe_poly& P, const fe25519* xs, const fe25519* ys, size_t n);
+
+#endif
@@ -4,17 +4,22 @@
 #include <vector>
 #include <cstddef>
 #include "helpers.hpp"
+#include "bin_table.hpp"
 
 // TODO: Add @brief
 
 class Receiver {
 public:
     uint256_t merkle_root;
-    vector<vector<uint256_t>> polys;
+    BinTable polys;  // one polynomial per bin, empty bins included
     size_t input_len;
     vector<uint256_t> ka_messages;
     vector<uint256_t> randomness;
     vector<uint256_t> input;
+    DigestTable digests;  // H_1 and bin of every input
+    BinConfig bin_config;  // public, the sender follows it
+    size_t merkle_arity;   // commitment tree arity, 2, 4 or 8; both parties use the same
+    CommitDomain commit_domain;  // public, the sender follows it
 
     Receiver(const uint256_t *input, size_t input_len);
     void commit();
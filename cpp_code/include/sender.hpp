@@ -2,6 +2,9 @@
 #define SENDER_HPP
 
 #include "helpers.hpp"
+#include "bin_table.hpp"
+#include "merkle.hpp"
+#include <string>
 #include <vector>
 #include <cstddef>
 
@@ -16,11 +19,21 @@ private:
     size_t input_len;
     std::vector<uint256_t> input;
     std::vector<uint256_t> random_values;
+    DigestTable digests;  // H_1 of every input; bins are assigned in intersect()
     friend std::vector<uint256_t> intersect(Receiver &receiver, Sender &sender, NetworkSimulator &net);
 
+    bool load_commitment();
+    void save_commitment() const;
+
 public:
     uint256_t merkle_root;
     std::vector<uint256_t> merkle_leaves;
+    size_t merkle_arity;  // commitment tree arity, 2, 4 or 8; both parties use the same
+    // If set, commit() keeps the whole tree and saves it to this path, with
+    // the random values in path + ".rand" (secret, like the input). A later
+    // commit() on the same input maps the tree back instead of rebuilding it.
+    std::string merkle_tree_path;
+    MerkleTree merkle_tree;  // only built with merkle_tree_path; serves inclusion proofs
 
     Sender(const uint256_t *input, size_t input_len);
     void commit();
@@ -0,0 +1,69 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing executor shared by the commit and intersection phases.
+//
+// Every worker owns a task deque: it pops its own work from the back and,
+// when that runs dry, steals from the front of the others. A thread waiting
+// on parallel_for() keeps running tasks instead of blocking, so nested
+// parallel_for() calls cannot deadlock. With one thread everything runs
+// inline on the caller.
+class ThreadPool {
+public:
+    // num_threads counts the calling thread, so n spawns n - 1 workers.
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return num_threads; }
+
+    // Calls body(lo, hi) on disjoint subranges covering [begin, end), each
+    // at most grain long (grain 0 picks a few chunks per thread). Returns
+    // once all of them finished; the first exception thrown is rethrown.
+    void parallel_for(size_t begin, size_t end, size_t grain,
+                      const std::function<void(size_t, size_t)>& body);
+
+    // Process-wide pool, created on first use with default_threads() threads.
+    static ThreadPool& instance();
+
+    // Must be called before the first instance(); 0 means one per core.
+    static void set_default_threads(size_t n);
+    static size_t default_threads();
+
+private:
+    struct TaskQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    size_t num_threads;
+    // queues[0] belongs to threads outside the pool, queues[i] to worker i
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;
+    std::atomic<bool> stopping;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    void push(size_t self, std::function<void()> task);
+    bool run_one(size_t self);
+    void worker_loop(size_t self);
+};
+
+// ThreadPool::instance().parallel_for(...)
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& body);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef X25519_BATCH_HPP
+#define X25519_BATCH_HPP
+
+#include <cstddef>
+#include "helpers.hpp"
+#include "field_batch.hpp"
+
+// Batched X25519 scalar multiplication.
+//
+// Results are byte-identical to crypto_x25519(out[i], scalar, point): the
+// scalar is trimmed the same way, bit 255 of the point is ignored and a
+// zero result stays zero. With AVX2 four Montgomery ladders run in lockstep,
+// one per 64-bit lane (field_avx2.hpp); otherwise each ladder runs on the
+// scalar 4x64 field code.
+//
+// Ladders stay projective; every batch_size results are converted to affine
+// together with one shared inversion (Montgomery's trick), which replaces
+// roughly 10% of a ladder's cost per element by three multiplications.
+
+// Default number of ladders sharing one inversion.
+const size_t X25519_BATCH_SIZE = 256;
+
+// out[i] = X25519(scalars[i], points[i])
+void x25519_batch(uint256_t *out, const uint256_t *scalars, const uint256_t *points,
+                  size_t n, size_t batch_size = X25519_BATCH_SIZE);
+
+// out[i] = X25519(scalar, points[i]), e.g. the sender's fixed key a
+void x25519_batch(uint256_t *out, const uint256_t &scalar, const uint256_t *points,
+                  size_t n, size_t batch_size = X25519_BATCH_SIZE);
+
+// out[i] = X25519(scalars[i], point), e.g. every b_i against m_sender
+void x25519_batch(uint256_t *out, const uint256_t *scalars, const uint256_t &point,
+                  size_t n, size_t batch_size = X25519_BATCH_SIZE);
+
+// out[i] = X25519(scalar, u_i) for u-coordinates already in field form, e.g.
+// polynomial evaluations; same as the byte version on their canonical
+// encodings. Groups of four feed the AVX2 ladder without conversion.
+void x25519_batch(uint256_t *out, const uint256_t &scalar, const FieldBatch &points,
+                  size_t batch_size = X25519_BATCH_SIZE);
+
+#endif
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "bin_table.hpp"
+#include "thread_pool.hpp"
+#include "drbg.hpp"
+
+// At most this many coarse buckets in the first partition pass, so every
+// block's histogram and write buffers stay in L2.
+static const size_t MAX_BUCKETS = 1024;
+
+// Indices buffered per bucket before a block flushes them to memory.
+static const size_t WRITE_BUFFER = 8;
+
+// Smallest block of elements worth its own histogram.
+static const size_t MIN_BLOCK = 4096;
+
+void BinTable::push_bin(const uint256_t *first, size_t count) {
+    values.insert(values.end(), first, first + count);
+    bin_offsets.push_back(values.size());
+}
+
+BinPartition partition_bins(const size_t *bins, size_t n, size_t num_bins) {
+    BinPartition partition;
+    partition.bin_offsets.assign(num_bins + 1, 0);
+    partition.members.resize(n);
+    if (n == 0 || num_bins == 0) {
+        if (n != 0) throw runtime_error("Bin index out of range");
+        return partition;
+    }
+
+    // Coarse bucket = bin >> shift
+    int shift = 0;
+    while (((num_bins - 1) >> shift) >= MAX_BUCKETS) shift++;
+    size_t num_buckets = ((num_bins - 1) >> shift) + 1;
+
+    size_t num_blocks = std::max<size_t>(1, std::min(4 * ThreadPool::instance().size(), n / MIN_BLOCK));
+    size_t block_len = (n + num_blocks - 1) / num_blocks;
+
+    // 1. Histogram of buckets per block
+    vector<size_t> counts(num_blocks * num_buckets, 0);
+    parallel_for(0, num_blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t blk = lo; blk < hi; blk++) {
+            size_t *hist = counts.data() + blk * num_buckets;
+            for (size_t i = blk * block_len; i < std::min(n, (blk + 1) * block_len); i++) {
+                if (bins[i] >= num_bins) {
+                    throw runtime_error("Bin index out of range");
+                }
+                hist[bins[i] >> shift]++;
+            }
+        }
+    });
+
+    // 2. Prefix sum, bucket-major then block, so every bucket keeps its
+    // elements in input order
+    vector<size_t> bucket_start(num_buckets + 1, 0);
+    size_t running = 0;
+    for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+        bucket_start[bucket] = running;
+        for (size_t blk = 0; blk < num_blocks; blk++) {
+            size_t c = counts[blk * num_buckets + bucket];
+            counts[blk * num_buckets + bucket] = running;
+            running += c;
+        }
+    }
+    bucket_start[num_buckets] = running;
+
+    // 3. Scatter indices by bucket through per-bucket write buffers
+    vector<size_t> by_bucket(n);
+    parallel_for(0, num_blocks, 1, [&](size_t lo, size_t hi) {
+        vector<size_t> buffer(num_buckets * WRITE_BUFFER);
+        vector<uint8_t> fill(num_buckets);
+        for (size_t blk = lo; blk < hi; blk++) {
+            size_t *cursor = counts.data() + blk * num_buckets;
+            std::fill(fill.begin(), fill.end(), 0);
+            for (size_t i = blk * block_len; i < std::min(n, (blk + 1) * block_len); i++) {
+                size_t bucket = bins[i] >> shift;
+                buffer[bucket * WRITE_BUFFER + fill[bucket]++] = i;
+                if (fill[bucket] == WRITE_BUFFER) {
+                    memcpy(by_bucket.data() + cursor[bucket], &buffer[bucket * WRITE_BUFFER],
+                           WRITE_BUFFER * sizeof(size_t));
+                    cursor[bucket] += WRITE_BUFFER;
+                    fill[bucket] = 0;
+                }
+            }
+            for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+                memcpy(by_bucket.data() + cursor[bucket], &buffer[bucket * WRITE_BUFFER],
+                       fill[bucket] * sizeof(size_t));
+                cursor[bucket] += fill[bucket];
+            }
+        }
+    });
+
+    // Each bucket covers a short run of bins; a local counting sort splits it
+    parallel_for(0, num_buckets, 0, [&](size_t lo, size_t hi) {
+        vector<size_t> local;
+        for (size_t bucket = lo; bucket < hi; bucket++) {
+            size_t first_bin = bucket << shift;
+            size_t last_bin = std::min(num_bins, (bucket + 1) << shift);
+            local.assign(last_bin - first_bin, 0);
+            for (size_t k = bucket_start[bucket]; k < bucket_start[bucket + 1]; k++) {
+                local[bins[by_bucket[k]] - first_bin]++;
+            }
+            size_t offset = bucket_start[bucket];
+            for (size_t b = first_bin; b < last_bin; b++) {
+                partition.bin_offsets[b] = offset;
+                size_t c = local[b - first_bin];
+                local[b - first_bin] = offset;
+                offset += c;
+            }
+            for (size_t k = bucket_start[bucket]; k < bucket_start[bucket + 1]; k++) {
+                size_t idx = by_bucket[k];
+                partition.members[local[bins[idx] - first_bin]++] = idx;
+            }
+        }
+    });
+    partition.bin_offsets[num_bins] = n;
+    return partition;
+}
+
+BinTable gather_bins(const uint256_t *values, const BinPartition &partition) {
+    BinTable table;
+    table.bin_offsets = partition.bin_offsets;
+    table.values.resize(partition.members.size());
+    parallel_for(0, partition.members.size(), 0, [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; k++) {
+            table.values[k] = values[partition.members[k]];
+        }
+    });
+    return table;
+}
+
+BinTable build_bin_table(const uint256_t *values, const size_t *bins, size_t n, size_t num_bins) {
+    return gather_bins(values, partition_bins(bins, n, num_bins));
+}
+
+BinPartition rebalance_singletons(const BinPartition &bins) {
+    size_t num_bins = bins.num_bins();
+    vector<size_t> sizes(num_bins), target(num_bins), next(num_bins + 1);
+    // next[i] = first bin at or after i that starts non-empty. Bins after i
+    // have not moved anything yet, so that is also the first one non-empty now.
+    next[num_bins] = num_bins;
+    for (size_t i = num_bins; i-- > 0;) {
+        sizes[i] = bins.bin_size(i);
+        target[i] = i;
+        next[i] = sizes[i] != 0 ? i : next[i + 1];
+    }
+    // Bins that receive an element already hold one, so they never become
+    // singletons themselves and every element moves at most once.
+    for (size_t i = 0; i < num_bins; i++) {
+        if (sizes[i] != 1) continue;
+        size_t j = next[i + 1];
+        if (j == num_bins) {
+            // Only the last non-empty bin wraps around, so this scan runs once
+            j = 0;
+            while (j < i && sizes[j] == 0) j++;
+        }
+        if (j == i) continue;
+        target[i] = j;
+        sizes[j]++;
+        sizes[i] = 0;
+    }
+
+    BinPartition result;
+    result.bin_offsets.assign(num_bins + 1, 0);
+    for (size_t b = 0; b < num_bins; b++) {
+        result.bin_offsets[b + 1] = result.bin_offsets[b] + sizes[b];
+    }
+    result.members.resize(bins.members.size());
+    // A bin's own elements first, then the incoming ones in bin order
+    vector<size_t> cursor(result.bin_offsets.begin(), result.bin_offsets.end() - 1);
+    for (size_t b = 0; b < num_bins; b++) {
+        if (target[b] != b) continue;
+        std::copy(bins.bin(b), bins.bin(b) + bins.bin_size(b), result.members.begin() + cursor[b]);
+        cursor[b] += bins.bin_size(b);
+    }
+    for (size_t i = 0; i < num_bins; i++) {
+        if (target[i] != i) result.members[cursor[target[i]]++] = bins.bin(i)[0];
+    }
+    return result;
+}
+
+size_t candidate_bin(const uint256_t &bin_hash, size_t j, size_t num_bins) {
+    size_t first = H_bin(bin_hash.bytes, num_bins);
+    if (j == 0 || num_bins < 2) return first;
+    // Offset in [1, num_bins) from the second word of the hash
+    return (first + 1 + H_bin(bin_hash.bytes + 8, num_bins - 1)) % num_bins;
+}
+
+// With a single bin there is nothing to choose between.
+static size_t effective_choices(BinStrategy strategy, size_t num_bins) {
+    return num_bins < 2 ? 1 : bin_choices(strategy);
+}
+
+// Greedy two-choice: each element, in input order, joins the less loaded
+// of its candidates (the first on a tie).
+static void assign_two_choice(vector<size_t> &bins, const vector<uint256_t> &bin_hash, size_t num_bins) {
+    size_t n = bin_hash.size();
+    vector<size_t> second(n);
+    parallel_for(0, n, 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            bins[i] = candidate_bin(bin_hash[i], 0, num_bins);
+            second[i] = candidate_bin(bin_hash[i], 1, num_bins);
+        }
+    });
+    vector<size_t> load(num_bins, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (load[second[i]] < load[bins[i]]) bins[i] = second[i];
+        load[bins[i]]++;
+    }
+}
+
+// Bucketized cuckoo hashing: bins of fixed capacity, random-walk eviction,
+// and a stash (bin num_bins) for elements still homeless after
+// CUCKOO_MAX_KICKS evictions. A stash overflow retries with one more slot
+// per bin. The walk is seeded with a constant, so placement only depends
+// on the input.
+static void assign_cuckoo(vector<size_t> &bins, const vector<uint256_t> &bin_hash, size_t num_bins) {
+    const size_t NONE = (size_t)-1;
+    size_t n = bin_hash.size();
+    vector<size_t> cand[2] = {vector<size_t>(n), vector<size_t>(n)};
+    parallel_for(0, n, 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            cand[0][i] = candidate_bin(bin_hash[i], 0, num_bins);
+            cand[1][i] = candidate_bin(bin_hash[i], 1, num_bins);
+        }
+    });
+
+    size_t capacity = (n + num_bins - 1) / num_bins + 1;
+    while (true) {
+        vector<size_t> slots(num_bins * capacity, NONE), load(num_bins, 0);
+        size_t stashed = 0;
+        uint64_t rng = 0x9e3779b97f4a7c15ULL;
+        for (size_t e = 0; e < n && stashed <= CUCKOO_STASH_SIZE; e++) {
+            size_t cur = e;
+            for (size_t kick = 0; ; kick++) {
+                size_t b0 = cand[0][cur], b1 = cand[1][cur];
+                size_t b = load[b0] < capacity ? b0 : (load[b1] < capacity ? b1 : NONE);
+                if (b != NONE) {
+                    slots[b * capacity + load[b]++] = cur;
+                    bins[cur] = b;
+                    break;
+                }
+                if (kick == CUCKOO_MAX_KICKS) {
+                    bins[cur] = num_bins;
+                    stashed++;
+                    break;
+                }
+                // Both full: swap cur with a random resident of one of them
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                b = (rng & 1) ? b1 : b0;
+                size_t &victim = slots[b * capacity + (size_t)((rng >> 1) % capacity)];
+                std::swap(cur, victim);
+                bins[victim] = b;
+            }
+        }
+        if (stashed <= CUCKOO_STASH_SIZE) return;
+        capacity++;
+    }
+}
+
+vector<size_t> candidate_pairs(const DigestTable &digests, size_t num_bins,
+                               BinStrategy strategy, bool with_stash, size_t &per_element) {
+    size_t choices = effective_choices(strategy, num_bins);
+    per_element = choices + (with_stash ? 1 : 0);
+    vector<size_t> pairs(digests.size() * per_element);
+    parallel_for(0, digests.size(), 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            for (size_t j = 0; j < choices; j++) {
+                pairs[i * per_element + j] = candidate_bin(digests.bin_hash[i], j, num_bins);
+            }
+            if (with_stash) pairs[i * per_element + choices] = num_bins;
+        }
+    });
+    return pairs;
+}
+
+size_t fixed_bin_load(size_t n, size_t num_bins, BinStrategy strategy) {
+    if (num_bins == 0) return 2;
+    size_t average = (n + num_bins - 1) / num_bins;
+    double margin;
+    switch (strategy) {
+    case BinStrategy::SIMPLE:
+        margin = std::sqrt(2.0 * average * std::log((double)num_bins + 1)) + 1;
+        break;
+    case BinStrategy::TWO_CHOICE:
+        margin = std::log2(std::log2((double)num_bins + 2) + 1) + 2;
+        break;
+    default:
+        margin = 1;  // the initial cuckoo capacity
+        break;
+    }
+    return std::max<size_t>(2, average + (size_t)std::ceil(margin));
+}
+
+void pad_with_dummies(vector<uint256_t> &xs, vector<uint256_t> &ys, size_t target) {
+    size_t count = xs.size();
+    if (count >= target) return;
+    xs.resize(target);
+    ys.resize(target);
+    ChaChaDrbg::local().fill(xs.data() + count, target - count);
+    ChaChaDrbg::local().fill(ys.data() + count, target - count);
+}
+
+void DigestTable::compute(const uint256_t *input, size_t n) {
+    h1.resize(n);
+    bin_hash.resize(n);
+    H_1_batch(h1.data(), input, n);
+    H_1_batch(bin_hash.data(), h1.data(), n);
+    num_bins = 0;
+}
+
+void DigestTable::assign_bins(size_t num_bins, BinStrategy strategy) {
+    size_t n = size();
+    this->num_bins = num_bins;
+    bins.resize(n);
+    if (effective_choices(strategy, num_bins) == 1) {
+        H_bin_batch(bins.data(), bin_hash.data(), n, num_bins);
+    } else if (strategy == BinStrategy::TWO_CHOICE) {
+        assign_two_choice(bins, bin_hash, num_bins);
+    } else {
+        assign_cuckoo(bins, bin_hash, num_bins);
+    }
+    size_t total_bins = num_bins + (strategy == BinStrategy::CUCKOO ? 1 : 0);
+    partition = partition_bins(bins.data(), n, total_bins);
+    max_load = 0;
+    for (size_t b = 0; b < num_bins; b++) {
+        max_load = std::max(max_load, partition.bin_size(b));
+    }
+    slots.resize(n);
+    parallel_for(0, total_bins, 0, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            for (size_t k = 0; k < partition.bin_size(b); k++) {
+                slots[partition.bin(b)[k]] = k;
+            }
+        }
+    });
+}
+
+BinTable flatten_bins(const vector<vector<uint256_t>> &bins) {
+    BinTable table(bins.size());
+    for (size_t b = 0; b < bins.size(); b++) {
+        table.bin_offsets[b + 1] = table.bin_offsets[b] + bins[b].size();
+    }
+    table.values.reserve(table.bin_offsets.back());
+    for (const auto &bin : bins) {
+        table.values.insert(table.values.end(), bin.begin(), bin.end());
+    }
+    return table;
+}
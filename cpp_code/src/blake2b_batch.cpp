@@ -0,0 +1,146 @@
+#include <cstring>
+#include "blake2b_batch.hpp"
+#include "field_batch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define APSI_HAVE_BLAKE2B_AVX2 1
+#include <immintrin.h>
+
+#define APSI_AVX2 __attribute__((target("avx2")))
+
+static const uint64_t BLAKE2B_IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t BLAKE2B_SIGMA[12][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+};
+
+static uint64_t load64_le(const uint8_t s[8]) {
+    uint64_t r = 0;
+    for (int i = 7; i >= 0; i--) {
+        r = (r << 8) | s[i];
+    }
+    return r;
+}
+
+APSI_AVX2 static inline __m256i rotr32(__m256i x) {
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+APSI_AVX2 static inline __m256i rotr24(__m256i x) {
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    return _mm256_shuffle_epi8(x, r24);
+}
+
+APSI_AVX2 static inline __m256i rotr16(__m256i x) {
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    return _mm256_shuffle_epi8(x, r16);
+}
+
+APSI_AVX2 static inline __m256i rotr63(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+#define BLAKE2B_G4(a, b, c, d, x, y)                                        \
+    do {                                                                    \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);                    \
+        d = rotr32(_mm256_xor_si256(d, a));                                 \
+        c = _mm256_add_epi64(c, d);                                         \
+        b = rotr24(_mm256_xor_si256(b, c));                                 \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);                    \
+        d = rotr16(_mm256_xor_si256(d, a));                                 \
+        c = _mm256_add_epi64(c, d);                                         \
+        b = rotr63(_mm256_xor_si256(b, c));                                 \
+    } while (0)
+
+// Hashes four single-block messages (msg_len <= 128), one per lane.
+APSI_AVX2 static void blake2b_256_x4(uint256_t out[4], const uint8_t *const msgs[4], size_t msg_len) {
+    // Message words, lane k holding message k (zero padded to the block)
+    __m256i m[16];
+    uint8_t block[4][BLAKE2B_BLOCK_BYTES];
+    for (int k = 0; k < 4; k++) {
+        memcpy(block[k], msgs[k], msg_len);
+        memset(block[k] + msg_len, 0, BLAKE2B_BLOCK_BYTES - msg_len);
+    }
+    for (int w = 0; w < 16; w++) {
+        m[w] = _mm256_set_epi64x((long long)load64_le(block[3] + 8 * w),
+                                 (long long)load64_le(block[2] + 8 * w),
+                                 (long long)load64_le(block[1] + 8 * w),
+                                 (long long)load64_le(block[0] + 8 * w));
+    }
+
+    // Parameter block: 32-byte digest, no key, fanout = depth = 1
+    __m256i h[8], v[16];
+    for (int i = 0; i < 8; i++) {
+        uint64_t word = BLAKE2B_IV[i] ^ (i == 0 ? 0x01010020ULL : 0);
+        h[i] = _mm256_set1_epi64x((long long)word);
+        v[i] = h[i];
+        v[i + 8] = _mm256_set1_epi64x((long long)BLAKE2B_IV[i]);
+    }
+    // Offset counter = msg_len, final-block flag set
+    v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x((long long)msg_len));
+    v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x(-1));
+
+    for (int r = 0; r < 12; r++) {
+        const uint8_t *s = BLAKE2B_SIGMA[r];
+        BLAKE2B_G4(v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]]);
+        BLAKE2B_G4(v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]]);
+        BLAKE2B_G4(v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]]);
+        BLAKE2B_G4(v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]]);
+        BLAKE2B_G4(v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]]);
+        BLAKE2B_G4(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        BLAKE2B_G4(v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]]);
+        BLAKE2B_G4(v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    // Only the first four state words make up a 32-byte digest
+    alignas(32) uint64_t words[4][4];
+    for (int i = 0; i < 4; i++) {
+        __m256i hi = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+        _mm256_store_si256((__m256i *)words[i], hi);
+    }
+    for (int k = 0; k < 4; k++) {
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 8; b++) {
+                out[k].bytes[8 * i + b] = (uint8_t)(words[i][k] >> (8 * b));
+            }
+        }
+    }
+}
+
+#endif
+
+void blake2b_256_batch(uint256_t *out, const uint8_t *in, size_t msg_len, size_t stride, size_t n) {
+    size_t i = 0;
+#ifdef APSI_HAVE_BLAKE2B_AVX2
+    if (msg_len <= BLAKE2B_BLOCK_BYTES && field_batch_avx2()) {
+        for (; i + 4 <= n; i += 4) {
+            const uint8_t *msgs[4] = {
+                in + i * stride, in + (i + 1) * stride,
+                in + (i + 2) * stride, in + (i + 3) * stride
+            };
+            blake2b_256_x4(out + i, msgs, msg_len);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        crypto_blake2b(out[i].bytes, 32, in + i * stride, msg_len);
+    }
+}
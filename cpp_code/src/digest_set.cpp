@@ -0,0 +1,104 @@
+#include <cstring>
+#include <stdexcept>
+#include "digest_set.hpp"
+#include "drbg.hpp"
+
+// Smallest table, and how far ahead contains_batch() prefetches.
+static const size_t MIN_CAPACITY = 16;
+static const size_t PREFETCH_DISTANCE = 8;
+
+DigestSet::DigestSet() : mask(0) {
+    uint256_t s;
+    ChaChaDrbg::local().fill(&s, 1);
+    memcpy(salt, s.bytes, sizeof(salt));
+    rehash(MIN_CAPACITY);
+}
+
+DigestSet::DigestSet(const uint256_t *keys, size_t n) : DigestSet() {
+    reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        insert(keys[i]);
+    }
+}
+
+uint64_t DigestSet::fingerprint(const uint256_t &key) const {
+    uint64_t w[4];
+    memcpy(w, key.bytes, sizeof(w));
+    // NH over the four words, then a splitmix finalizer for the low bits
+    uint64_t h = (w[0] + salt[0]) * (w[1] + salt[1]) + (w[2] + salt[2]) * (w[3] + salt[3]);
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h == 0 ? 1 : h;
+}
+
+size_t DigestSet::find(const uint256_t &key, uint64_t fp) const {
+    size_t slot = fp & mask;
+    while (fingerprints[slot] != 0) {
+        if (fingerprints[slot] == fp && keys[slot_keys[slot]] == key) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void DigestSet::rehash(size_t capacity) {
+    fingerprints.assign(capacity, 0);
+    slot_keys.assign(capacity, 0);
+    mask = capacity - 1;
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint64_t fp = fingerprint(keys[i]);
+        size_t slot = fp & mask;
+        while (fingerprints[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        fingerprints[slot] = fp;
+        slot_keys[slot] = (uint32_t)i;
+    }
+}
+
+void DigestSet::reserve(size_t n) {
+    if (n > UINT32_MAX) {
+        throw std::runtime_error("DigestSet holds at most 2^32 keys");
+    }
+    // Keep the load factor at or below 1/2
+    size_t capacity = fingerprints.size();
+    while (capacity < 2 * n) capacity *= 2;
+    if (capacity != fingerprints.size()) rehash(capacity);
+    keys.reserve(n);
+}
+
+bool DigestSet::insert(const uint256_t &key) {
+    if (2 * (keys.size() + 1) > fingerprints.size()) {
+        reserve(keys.size() + 1);
+    }
+    uint64_t fp = fingerprint(key);
+    size_t slot = find(key, fp);
+    if (fingerprints[slot] != 0) return false;
+    fingerprints[slot] = fp;
+    slot_keys[slot] = (uint32_t)keys.size();
+    keys.push_back(key);
+    return true;
+}
+
+bool DigestSet::contains(const uint256_t &key) const {
+    return fingerprints[find(key, fingerprint(key))] != 0;
+}
+
+void DigestSet::contains_batch(uint8_t *found, const uint256_t *queries, size_t n) const {
+    // Fingerprints first, so the slot of query i + PREFETCH_DISTANCE is
+    // already on its way while query i probes
+    std::vector<uint64_t> fps(n);
+    for (size_t i = 0; i < n; i++) {
+        fps[i] = fingerprint(queries[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n) {
+            size_t ahead = fps[i + PREFETCH_DISTANCE] & mask;
+            __builtin_prefetch(&fingerprints[ahead]);
+            __builtin_prefetch(&slot_keys[ahead]);
+        }
+        found[i] = fingerprints[find(queries[i], fps[i])] != 0;
+    }
+}
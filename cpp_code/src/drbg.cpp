@@ -0,0 +1,104 @@
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/random.h>  // getentropy; glibc declares it in unistd.h
+#endif
+#include "drbg.hpp"
+#include "monocypher.hpp"
+
+static const uint8_t ZERO_NONCE[8] = {0};
+
+// Process seed every per-thread key is derived from.
+static std::mutex seed_mutex;
+static uint8_t master_key[32];
+static bool master_seeded = false;
+static uint64_t next_stream = 0;
+
+// getentropy() exists on Linux (glibc 2.25+) and macOS alike, but hands
+// out at most 256 bytes per call.
+static void os_entropy(uint8_t *out, size_t len) {
+    for (size_t done = 0; done < len; done += 256) {
+        size_t chunk = len - done < 256 ? len - done : 256;
+        if (getentropy(out + done, chunk) != 0) {
+            throw std::runtime_error("getentropy failed");
+        }
+    }
+}
+
+ChaChaDrbg::ChaChaDrbg(const uint8_t key[32]) : used(DRBG_BUFFER_BYTES) {
+    memcpy(this->key, key, 32);
+}
+
+ChaChaDrbg::~ChaChaDrbg() {
+    crypto_wipe(key, sizeof(key));
+    crypto_wipe(buffer, sizeof(buffer));
+}
+
+void ChaChaDrbg::refill() {
+    // Every refill uses a fresh key, so the nonce and counter can stay zero
+    crypto_chacha20_djb(buffer, nullptr, DRBG_BUFFER_BYTES, key, ZERO_NONCE, 0);
+    memcpy(key, buffer, 32);
+    crypto_wipe(buffer, 32);
+    used = 32;
+}
+
+void ChaChaDrbg::fill(uint8_t *out, size_t len) {
+    // Drain what is left in the buffer, wiping bytes as they are handed out
+    size_t take = len < DRBG_BUFFER_BYTES - used ? len : DRBG_BUFFER_BYTES - used;
+    memcpy(out, buffer + used, take);
+    crypto_wipe(buffer + used, take);
+    used += take;
+    out += take;
+    len -= take;
+    if (len == 0) return;
+
+    if (len >= DRBG_BUFFER_BYTES) {
+        // Bulk requests skip the buffer: block 0 becomes the next key and
+        // the stream from block 1 on goes straight to out
+        uint8_t next[64];
+        crypto_chacha20_djb(next, nullptr, 64, key, ZERO_NONCE, 0);
+        crypto_chacha20_djb(out, nullptr, len, key, ZERO_NONCE, 1);
+        memcpy(key, next, 32);
+        crypto_wipe(next, sizeof(next));
+        return;
+    }
+
+    refill();
+    memcpy(out, buffer + used, len);
+    crypto_wipe(buffer + used, len);
+    used += len;
+}
+
+ChaChaDrbg &ChaChaDrbg::local() {
+    static thread_local std::unique_ptr<ChaChaDrbg> drbg;
+    if (!drbg) {
+        uint8_t in[16] = {0};
+        uint8_t key[32];
+        {
+            std::lock_guard<std::mutex> lock(seed_mutex);
+            if (!master_seeded) {
+                os_entropy(master_key, sizeof(master_key));
+                master_seeded = true;
+            }
+            // Thread streams are numbered in order of first use
+            uint64_t stream = next_stream++;
+            for (int i = 0; i < 8; i++) in[i] = (uint8_t)(stream >> (8 * i));
+            crypto_chacha20_h(key, master_key, in);
+        }
+        drbg.reset(new ChaChaDrbg(key));
+        crypto_wipe(key, sizeof(key));
+    }
+    return *drbg;
+}
+
+void ChaChaDrbg::set_seed(uint64_t seed) {
+    std::lock_guard<std::mutex> lock(seed_mutex);
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = (uint8_t)(seed >> (8 * i));
+    crypto_blake2b(master_key, sizeof(master_key), bytes, sizeof(bytes));
+    master_seeded = true;
+    next_stream = 0;
+}
@@ -0,0 +1,141 @@
+#include <cstring>
+#include <vector>
+#include "field.hpp"
+
+static uint64_t load64_le(const uint8_t s[8]) {
+    uint64_t r = 0;
+    for (int i = 7; i >= 0; i--) {
+        r = (r << 8) | s[i];
+    }
+    return r;
+}
+
+static void store64_le(uint8_t out[8], uint64_t x) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(x >> (8 * i));
+    }
+}
+
+void fe_canonical(fe25519 &h, const fe25519 &f) {
+    uint64_t t[4] = {f.v[0], f.v[1], f.v[2], f.v[3]};
+
+    // Fold bit 255 (2^255 = 19 mod p): the result is below 2^255 + 19.
+    uint64_t top = t[3] >> 63;
+    t[3] &= 0x7fffffffffffffffULL;
+    fe_u128 c = (fe_u128)t[0] + 19 * top;
+    t[0] = (uint64_t)c; c >>= 64;
+    for (int i = 1; i < 4; i++) {
+        c += t[i]; t[i] = (uint64_t)c; c >>= 64;
+    }
+
+    // t >= p exactly when t + 19 reaches bit 255.
+    c = (fe_u128)t[0] + 19;
+    for (int i = 1; i < 4; i++) {
+        c >>= 64;
+        c += t[i];
+    }
+    uint64_t q = (uint64_t)c >> 63;
+
+    c = (fe_u128)t[0] + 19 * q;
+    h.v[0] = (uint64_t)c; c >>= 64;
+    for (int i = 1; i < 4; i++) {
+        c += t[i]; h.v[i] = (uint64_t)c; c >>= 64;
+    }
+    h.v[3] &= 0x7fffffffffffffffULL;
+}
+
+void fe_invert(fe25519 &out, const fe25519 &z) {
+    // z^(2^255 - 21), same addition chain as ref10.
+    fe25519 t0, t1, t2, t3;
+    fe_sq(t0, z);
+    fe_sqn(t1, t0, 2);
+    fe_mul(t1, z, t1);
+    fe_mul(t0, t0, t1);
+    fe_sq(t2, t0);
+    fe_mul(t1, t1, t2);       // 2^5 - 1
+    fe_sqn(t2, t1, 5);
+    fe_mul(t1, t2, t1);       // 2^10 - 1
+    fe_sqn(t2, t1, 10);
+    fe_mul(t2, t2, t1);       // 2^20 - 1
+    fe_sqn(t3, t2, 20);
+    fe_mul(t2, t3, t2);       // 2^40 - 1
+    fe_sqn(t2, t2, 10);
+    fe_mul(t1, t2, t1);       // 2^50 - 1
+    fe_sqn(t2, t1, 50);
+    fe_mul(t2, t2, t1);       // 2^100 - 1
+    fe_sqn(t3, t2, 100);
+    fe_mul(t2, t3, t2);       // 2^200 - 1
+    fe_sqn(t2, t2, 50);
+    fe_mul(t1, t2, t1);       // 2^250 - 1
+    fe_sqn(t1, t1, 5);
+    fe_mul(out, t1, t0);      // 2^255 - 21
+}
+
+void fe_batch_invert(fe25519 *out, const fe25519 *in, size_t n) {
+    if (n == 0) return;
+
+    // prefix[i] = in[0] * ... * in[i], with zeros counted as 1 so that one
+    // zero does not wipe out every other result
+    std::vector<fe25519> prefix(n);
+    std::vector<uint8_t> is_zero(n);
+    for (size_t i = 0; i < n; i++) {
+        is_zero[i] = fe_is_zero(in[i]);
+        const fe25519 x = is_zero[i] ? fe_one() : in[i];
+        if (i == 0) prefix[0] = x;
+        else fe_mul(prefix[i], prefix[i - 1], x);
+    }
+
+    fe25519 inv;
+    fe_invert(inv, prefix[n - 1]);
+    for (size_t i = n - 1; i > 0; i--) {
+        const fe25519 x = is_zero[i] ? fe_one() : in[i];
+        fe_mul(out[i], inv, prefix[i - 1]);
+        fe_mul(inv, inv, x);
+        if (is_zero[i]) out[i] = fe_zero();
+    }
+    out[0] = is_zero[0] ? fe_zero() : inv;
+}
+
+void fe_pow(fe25519 &h, const fe25519 &f, const uint64_t e[4]) {
+    fe25519 result = fe_one();
+    fe25519 base = f;
+    for (int limb = 0; limb < 4; limb++) {
+        for (int bit = 0; bit < 64; bit++) {
+            if ((e[limb] >> bit) & 1) {
+                fe_mul(result, result, base);
+            }
+            fe_sq(base, base);
+        }
+    }
+    h = result;
+}
+
+bool fe_is_zero(const fe25519 &f) {
+    fe25519 t;
+    fe_canonical(t, f);
+    return (t.v[0] | t.v[1] | t.v[2] | t.v[3]) == 0;
+}
+
+bool fe_equal(const fe25519 &f, const fe25519 &g) {
+    fe25519 d;
+    fe_sub(d, f, g);
+    return fe_is_zero(d);
+}
+
+fe25519 fe_from_bytes(const uint8_t bytes[32]) {
+    fe25519 h;
+    for (int i = 0; i < 4; i++) {
+        h.v[i] = load64_le(bytes + 8 * i);
+    }
+    return h;
+}
+
+uint256_t fe_to_bytes(const fe25519 &f) {
+    fe25519 t;
+    fe_canonical(t, f);
+    uint256_t result;
+    for (int i = 0; i < 4; i++) {
+        store64_le(result.bytes + 8 * i, t.v[i]);
+    }
+    return result;
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+#include "field_batch.hpp"
+#include "field_avx2.hpp"
+
+// Kernels specialized on the number of coefficients. The coefficient loop
+// has a compile-time trip count, and every kernel runs two independent
+// Horner chains over different points, so one chain's multiply overlaps the
+// other's instead of waiting on its own previous result.
+
+template <size_t NCOEFFS>
+static void poly_eval_fixed(fe25519 *out, const fe25519 *coeffs, const fe25519 *points, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        fe25519 x0 = points[i], x1 = points[i + 1];
+        fe25519 a0 = coeffs[NCOEFFS - 1], a1 = a0;
+        for (size_t c = NCOEFFS - 1; c > 0; c--) {
+            fe_mul_add(a0, a0, x0, coeffs[c - 1]);
+            fe_mul_add(a1, a1, x1, coeffs[c - 1]);
+        }
+        out[i] = a0;
+        out[i + 1] = a1;
+    }
+    if (i < n) {
+        fe25519 x = points[i], acc = coeffs[NCOEFFS - 1];
+        for (size_t c = NCOEFFS - 1; c > 0; c--) {
+            fe_mul_add(acc, acc, x, coeffs[c - 1]);
+        }
+        out[i] = acc;
+    }
+}
+
+typedef void (*poly_eval_kernel)(fe25519 *, const fe25519 *, const fe25519 *, size_t);
+
+// Jump table: entry ncoeffs - 1 evaluates exactly ncoeffs coefficients.
+template <size_t... N>
+static constexpr std::array<poly_eval_kernel, sizeof...(N)> poly_eval_table(std::index_sequence<N...>) {
+    return {{&poly_eval_fixed<N + 1>...}};
+}
+static constexpr auto POLY_EVAL_KERNELS =
+    poly_eval_table(std::make_index_sequence<POLY_EVAL_SPECIALIZED_MAX>());
+
+#ifdef APSI_HAVE_AVX2_KERNELS
+
+// AVX2 version on eight points per step: two chains of four lanes.
+// Coefficients come pre-split into limbs, as in poly_eval_batch_avx2().
+template <size_t NCOEFFS>
+APSI_AVX2 static void poly_eval_fixed_avx2(fe25519 *out, const uint64_t *limbs,
+                                           const fe25519 *points, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        fe25519x4 x0, x1, a0, a1;
+        fe4_load(x0, points + i, 4);
+        fe4_load(x1, points + i + 4, 4);
+        fe4_broadcast(a0, limbs + 10 * (NCOEFFS - 1));
+        a1 = a0;
+        for (size_t c = NCOEFFS - 1; c > 0; c--) {
+            fe4_mul(a0, a0, x0);
+            fe4_mul(a1, a1, x1);
+            const uint64_t *coeff = limbs + 10 * (c - 1);
+            for (int k = 0; k < 10; k++) {
+                __m256i limb = _mm256_set1_epi64x((long long)coeff[k]);
+                a0.l[k] = _mm256_add_epi64(a0.l[k], limb);
+                a1.l[k] = _mm256_add_epi64(a1.l[k], limb);
+            }
+        }
+        fe4_carry(a0);
+        fe4_carry(a1);
+        fe4_store(out + i, a0, 4);
+        fe4_store(out + i + 4, a1, 4);
+    }
+    for (; i < n; i += 4) {
+        size_t count = n - i < 4 ? n - i : 4;
+        fe25519x4 x, acc;
+        fe4_load(x, points + i, count);
+        fe4_broadcast(acc, limbs + 10 * (NCOEFFS - 1));
+        for (size_t c = NCOEFFS - 1; c > 0; c--) {
+            fe4_mul(acc, acc, x);
+            const uint64_t *coeff = limbs + 10 * (c - 1);
+            for (int k = 0; k < 10; k++) {
+                acc.l[k] = _mm256_add_epi64(acc.l[k], _mm256_set1_epi64x((long long)coeff[k]));
+            }
+        }
+        fe4_carry(acc);
+        fe4_store(out + i, acc, count);
+    }
+}
+
+typedef void (*poly_eval_kernel_avx2)(fe25519 *, const uint64_t *, const fe25519 *, size_t);
+
+template <size_t... N>
+static constexpr std::array<poly_eval_kernel_avx2, sizeof...(N)> poly_eval_table_avx2(std::index_sequence<N...>) {
+    return {{&poly_eval_fixed_avx2<N + 1>...}};
+}
+static constexpr auto POLY_EVAL_KERNELS_AVX2 =
+    poly_eval_table_avx2(std::make_index_sequence<POLY_EVAL_SPECIALIZED_MAX>());
+
+APSI_AVX2 static void mul_batch_avx2(fe25519 *out, const fe25519 *a, const fe25519 *b, size_t n) {
+    for (size_t i = 0; i < n; i += 4) {
+        size_t count = n - i < 4 ? n - i : 4;
+        fe25519x4 x, y;
+        fe4_load(x, a + i, count);
+        fe4_load(y, b + i, count);
+        fe4_mul(x, x, y);
+        fe4_store(out + i, x, count);
+    }
+}
+
+APSI_AVX2 static void sq_batch_avx2(fe25519 *out, const fe25519 *a, size_t n) {
+    for (size_t i = 0; i < n; i += 4) {
+        size_t count = n - i < 4 ? n - i : 4;
+        fe25519x4 x;
+        fe4_load(x, a + i, count);
+        fe4_sq(x, x);
+        fe4_store(out + i, x, count);
+    }
+}
+
+APSI_AVX2 static void poly_eval_batch_avx2(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                                           const fe25519 *points, size_t n) {
+    // Split every coefficient once; Horner then only adds broadcast limbs.
+    std::vector<uint64_t> limbs(10 * ncoeffs);
+    for (size_t i = 0; i < ncoeffs; i++) {
+        fe_to_limbs10(&limbs[10 * i], coeffs[i]);
+    }
+    if (ncoeffs <= POLY_EVAL_SPECIALIZED_MAX) {
+        POLY_EVAL_KERNELS_AVX2[ncoeffs - 1](out, limbs.data(), points, n);
+        return;
+    }
+
+    for (size_t i = 0; i < n; i += 4) {
+        size_t count = n - i < 4 ? n - i : 4;
+        fe25519x4 x, acc;
+        fe4_load(x, points + i, count);
+        fe4_broadcast(acc, &limbs[10 * (ncoeffs - 1)]);
+        for (size_t c = ncoeffs - 1; c > 0; c--) {
+            fe4_mul(acc, acc, x);
+            // acc is carried and the coefficient is tight, so the sum stays
+            // within fe4_mul's input bound without another carry.
+            const uint64_t *coeff = &limbs[10 * (c - 1)];
+            for (int k = 0; k < 10; k++) {
+                acc.l[k] = _mm256_add_epi64(acc.l[k], _mm256_set1_epi64x((long long)coeff[k]));
+            }
+        }
+        fe4_carry(acc);
+        fe4_store(out + i, acc, count);
+    }
+}
+
+APSI_AVX2 static void poly_eval_lockstep_avx2(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                                              const size_t *which, const fe25519 *points, size_t n) {
+    for (size_t i = 0; i < n; i += 4) {
+        size_t count = n - i < 4 ? n - i : 4;
+        // Missing lanes reuse the first polynomial; their results are dropped
+        const fe25519 *lane[4];
+        for (size_t l = 0; l < 4; l++) {
+            lane[l] = coeffs + ncoeffs * which[i + (l < count ? l : 0)];
+        }
+        fe25519 gathered[4];
+        fe25519x4 x, acc, coeff;
+        fe4_load(x, points + i, count);
+        for (size_t l = 0; l < 4; l++) gathered[l] = lane[l][ncoeffs - 1];
+        fe4_load(acc, gathered, 4);
+        for (size_t c = ncoeffs - 1; c > 0; c--) {
+            fe4_mul(acc, acc, x);
+            // Same bound argument as poly_eval_batch_avx2: tight coefficient
+            // limbs on a carried accumulator
+            for (size_t l = 0; l < 4; l++) gathered[l] = lane[l][c - 1];
+            fe4_load(coeff, gathered, 4);
+            for (int k = 0; k < 10; k++) {
+                acc.l[k] = _mm256_add_epi64(acc.l[k], coeff.l[k]);
+            }
+        }
+        fe4_carry(acc);
+        fe4_store(out + i, acc, count);
+    }
+}
+
+static bool detect_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+static bool detect_avx2() {
+    return false;
+}
+
+#endif
+
+bool field_batch_avx2() {
+    static const bool has_avx2 = detect_avx2();
+    return has_avx2;
+}
+
+void fe_mul_batch(fe25519 *out, const fe25519 *a, const fe25519 *b, size_t n) {
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        mul_batch_avx2(out, a, b, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        fe_mul(out[i], a[i], b[i]);
+    }
+}
+
+void fe_sq_batch(fe25519 *out, const fe25519 *a, size_t n) {
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        sq_batch_avx2(out, a, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        fe_sq(out[i], a[i]);
+    }
+}
+
+void fe_poly_eval_batch(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                        const fe25519 *points, size_t n) {
+    if (ncoeffs == 0) {
+        for (size_t i = 0; i < n; i++) out[i] = fe_zero();
+        return;
+    }
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        poly_eval_batch_avx2(out, coeffs, ncoeffs, points, n);
+        return;
+    }
+#endif
+    if (ncoeffs <= POLY_EVAL_SPECIALIZED_MAX) {
+        POLY_EVAL_KERNELS[ncoeffs - 1](out, coeffs, points, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        fe25519 x = points[i];
+        fe25519 acc = coeffs[ncoeffs - 1];
+        for (size_t c = ncoeffs - 1; c > 0; c--) {
+            fe_mul_add(acc, acc, x, coeffs[c - 1]);
+        }
+        out[i] = acc;
+    }
+}
+
+void fe_poly_eval_lockstep(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                           const size_t *which, const fe25519 *points, size_t n) {
+    if (ncoeffs == 0) {
+        for (size_t i = 0; i < n; i++) out[i] = fe_zero();
+        return;
+    }
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        poly_eval_lockstep_avx2(out, coeffs, ncoeffs, which, points, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        const fe25519 *f = coeffs + ncoeffs * which[i];
+        fe25519 x = points[i];
+        fe25519 acc = f[ncoeffs - 1];
+        for (size_t c = ncoeffs - 1; c > 0; c--) {
+            fe_mul_add(acc, acc, x, f[c - 1]);
+        }
+        out[i] = acc;
+    }
+}
+
+void fe_poly_eval_progression(fe25519 *out, const fe25519 *coeffs, size_t ncoeffs,
+                              uint64_t first, size_t n) {
+    if (ncoeffs == 0) {
+        for (size_t i = 0; i < n; i++) out[i] = fe_zero();
+        return;
+    }
+    for (size_t j = 0; j < n; j++) {
+        fe25519 acc = coeffs[ncoeffs - 1];
+        for (size_t c = ncoeffs - 1; c > 0; c--) {
+            fe_mul_small_add(acc, acc, first + j, coeffs[c - 1]);
+        }
+        out[j] = acc;
+    }
+}
+
+fe25519 FieldBatch::get(size_t i) const {
+    const fe_limbs4 &g = groups[i / 4];
+    uint64_t limbs[10];
+    for (int k = 0; k < 10; k++) limbs[k] = g.l[k][i % 4];
+    fe25519 f;
+    fe_from_limbs10(f, limbs);
+    return f;
+}
+
+void FieldBatch::set(size_t i, const fe25519 &f) {
+    fe_limbs4 &g = groups[i / 4];
+    uint64_t limbs[10];
+    fe_to_limbs10(limbs, f);
+    for (int k = 0; k < 10; k++) g.l[k][i % 4] = limbs[k];
+}
+
+FieldBatch FieldBatch::from_bytes(const uint256_t *in, size_t n) {
+    FieldBatch batch(n);
+    for (size_t i = 0; i < n; i++) batch.set(i, fe_from_bytes(in[i]));
+    return batch;
+}
+
+FieldBatch FieldBatch::from_fe(const fe25519 *in, size_t n) {
+    FieldBatch batch(n);
+    for (size_t i = 0; i < n; i++) batch.set(i, in[i]);
+    return batch;
+}
+
+void FieldBatch::to_bytes(uint256_t *out) const {
+    for (size_t i = 0; i < count; i++) out[i] = fe_to_bytes(get(i));
+}
+
+vector<uint256_t> FieldBatch::to_bytes() const {
+    vector<uint256_t> out(count);
+    to_bytes(out.data());
+    return out;
+}
+
+void FieldBatch::to_fe(fe25519 *out) const {
+    for (size_t i = 0; i < count; i++) out[i] = get(i);
+}
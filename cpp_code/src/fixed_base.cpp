@@ -0,0 +1,288 @@
+#include <cstring>
+#include "fixed_base.hpp"
+#include "thread_pool.hpp"
+
+// Extended twisted Edwards coordinates: x = X/Z, y = Y/Z, x * y = T/Z.
+struct ge_p3 {
+    fe25519 X, Y, Z, T;
+};
+
+struct curve_constants {
+    fe25519 d, d2, sqrt_m1;
+
+    curve_constants() {
+        // d = -121665 / 121666
+        fe25519 num = fe_from_u64(121665), den = fe_from_u64(121666);
+        fe_invert(den, den);
+        fe_mul(d, num, den);
+        fe_neg(d, d);
+        fe_add(d2, d, d);
+        // sqrt(-1) = 2^((p - 1) / 4)
+        const uint64_t e[4] = {
+            0xfffffffffffffffbULL, 0xffffffffffffffffULL,
+            0xffffffffffffffffULL, 0x1fffffffffffffffULL
+        };
+        fe_pow(sqrt_m1, fe_from_u64(2), e);
+    }
+};
+
+static const curve_constants &constants() {
+    static const curve_constants c;
+    return c;
+}
+
+static void ge_identity(ge_p3 &p) {
+    p.X = fe_zero();
+    p.Y = fe_one();
+    p.Z = fe_one();
+    p.T = fe_zero();
+}
+
+// r = p + q (add-2008-hwcd-3, a = -1)
+static void ge_add(ge_p3 &r, const ge_p3 &p, const ge_p3 &q) {
+    fe25519 a, b, c, d, e, f, g, h, t;
+    fe_sub(a, p.Y, p.X);
+    fe_sub(t, q.Y, q.X);
+    fe_mul(a, a, t);
+    fe_add(b, p.Y, p.X);
+    fe_add(t, q.Y, q.X);
+    fe_mul(b, b, t);
+    fe_mul(c, p.T, q.T);
+    fe_mul(c, c, constants().d2);
+    fe_mul(d, p.Z, q.Z);
+    fe_add(d, d, d);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r.X, e, f);
+    fe_mul(r.Y, g, h);
+    fe_mul(r.T, e, h);
+    fe_mul(r.Z, f, g);
+}
+
+// r = p + q for an affine table entry q
+static void ge_madd(ge_p3 &r, const ge_p3 &p, const ge_niels &q) {
+    fe25519 a, b, c, d, e, f, g, h;
+    fe_sub(a, p.Y, p.X);
+    fe_mul(a, a, q.ymx);
+    fe_add(b, p.Y, p.X);
+    fe_mul(b, b, q.ypx);
+    fe_mul(c, p.T, q.xy2d);
+    fe_add(d, p.Z, p.Z);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r.X, e, f);
+    fe_mul(r.Y, g, h);
+    fe_mul(r.T, e, h);
+    fe_mul(r.Z, f, g);
+}
+
+// r = 2 * p (dbl-2008-hwcd, a = -1)
+static void ge_dbl(ge_p3 &r, const ge_p3 &p) {
+    fe25519 a, b, c, e, f, g, h, t;
+    fe_sq(a, p.X);
+    fe_sq(b, p.Y);
+    fe_sq(c, p.Z);
+    fe_add(c, c, c);
+    fe_add(t, p.X, p.Y);
+    fe_sq(e, t);
+    fe_sub(e, e, a);
+    fe_sub(e, e, b);
+    fe_sub(g, b, a);       // g = -a + b
+    fe_sub(f, g, c);
+    fe_neg(h, a);
+    fe_sub(h, h, b);       // h = -a - b
+    fe_mul(r.X, e, f);
+    fe_mul(r.Y, g, h);
+    fe_mul(r.T, e, h);
+    fe_mul(r.Z, f, g);
+}
+
+// Lifts a Montgomery u-coordinate to an Edwards point with
+// y = (u - 1) / (u + 1). Either square root for x works, since P and -P
+// share their u-coordinate. Returns false if u is not on the curve.
+static bool ge_from_montgomery(ge_p3 &p, const uint256_t &base) {
+    uint8_t u_bytes[32];
+    memcpy(u_bytes, base.bytes, 32);
+    u_bytes[31] &= 0x7f;
+    fe25519 u = fe_from_bytes(u_bytes);
+
+    fe25519 num, den, y;
+    fe_sub(num, u, fe_one());
+    fe_add(den, u, fe_one());
+    if (fe_is_zero(den)) return false;
+    fe_invert(den, den);
+    fe_mul(y, num, den);
+
+    // x^2 = (y^2 - 1) / (d y^2 + 1) = s / v
+    fe25519 y2, s, v;
+    fe_sq(y2, y);
+    fe_sub(s, y2, fe_one());
+    fe_mul(v, y2, constants().d);
+    fe_add(v, v, fe_one());
+
+    // x = s v^3 (s v^7)^((p - 5) / 8), times sqrt(-1) if that squares to -s/v
+    const uint64_t e[4] = {
+        0xfffffffffffffffdULL, 0xffffffffffffffffULL,
+        0xffffffffffffffffULL, 0x0fffffffffffffffULL
+    };
+    fe25519 v3, v7, x, t, check;
+    fe_sq(v3, v);
+    fe_mul(v3, v3, v);
+    fe_sq(v7, v3);
+    fe_mul(v7, v7, v);
+    fe_mul(t, s, v7);
+    fe_pow(t, t, e);
+    fe_mul(x, s, v3);
+    fe_mul(x, x, t);
+
+    fe_sq(check, x);
+    fe_mul(check, check, v);
+    if (!fe_equal(check, s)) {
+        fe25519 neg_s;
+        fe_neg(neg_s, s);
+        if (!fe_equal(check, neg_s)) return false;
+        fe_mul(x, x, constants().sqrt_m1);
+    }
+
+    p.X = x;
+    p.Y = y;
+    p.Z = fe_one();
+    fe_mul(p.T, x, y);
+    return true;
+}
+
+FixedBaseTable::FixedBaseTable(const uint256_t &base) {
+    ge_p3 P;
+    if (!ge_from_montgomery(P, base)) return;
+
+    // Projective multiples first, then one shared inversion for all of them.
+    std::vector<ge_p3> points(WINDOWS * ENTRIES);
+    for (size_t i = 0; i < WINDOWS; i++) {
+        points[i * ENTRIES] = P;
+        for (size_t j = 1; j < ENTRIES; j++) {
+            ge_add(points[i * ENTRIES + j], points[i * ENTRIES + j - 1], P);
+        }
+        for (int k = 0; k < 4; k++) {
+            ge_dbl(P, P);
+        }
+    }
+
+    std::vector<fe25519> inv(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        inv[i] = points[i].Z;
+    }
+    fe_batch_invert(inv.data(), inv.data(), inv.size());
+
+    table.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        fe25519 x, y;
+        fe_mul(x, points[i].X, inv[i]);
+        fe_mul(y, points[i].Y, inv[i]);
+        fe_add(table[i].ypx, y, x);
+        fe_sub(table[i].ymx, y, x);
+        fe_mul(table[i].xy2d, x, y);
+        fe_mul(table[i].xy2d, table[i].xy2d, constants().d2);
+    }
+}
+
+// Constant-time t = (digit >= 0 ? 1 : -1) * |digit| * 16^i * P, digit in [-8, 8].
+static void select_entry(ge_niels &t, const ge_niels *window, int8_t digit) {
+    uint8_t negative = (uint8_t)digit >> 7;
+    uint8_t magnitude = (uint8_t)((digit ^ -negative) + negative);
+
+    t.ypx = fe_one();
+    t.ymx = fe_one();
+    t.xy2d = fe_zero();
+    for (size_t j = 1; j <= FixedBaseTable::ENTRIES; j++) {
+        uint64_t take = (uint64_t)(((magnitude ^ j) - 1) >> 63) & 1;
+        ge_niels candidate = window[j - 1];
+        fe_cswap(t.ypx, candidate.ypx, take);
+        fe_cswap(t.ymx, candidate.ymx, take);
+        fe_cswap(t.xy2d, candidate.xy2d, take);
+    }
+
+    // -(x, y) = (-x, y): swap y + x with y - x and negate 2dxy
+    fe25519 neg_xy2d;
+    fe_neg(neg_xy2d, t.xy2d);
+    fe_cswap(t.ypx, t.ymx, negative);
+    fe_cswap(t.xy2d, neg_xy2d, negative);
+}
+
+void FixedBaseTable::scalarmult_batch(uint256_t *out, const uint256_t *scalars, size_t n,
+                                      size_t batch_size) const {
+    if (batch_size == 0) batch_size = 1;
+
+    // Each batch (one shared inversion) is a task of its own
+    parallel_for(0, n, batch_size, [&](size_t start, size_t end) {
+        size_t count = end - start;
+        std::vector<fe25519> num(count), den(count);
+        for (size_t k = 0; k < count; k++) {
+            // Trim as crypto_x25519 does, then recode into signed radix-16
+            // digits e[i] in [-8, 8) (the top digit may reach 8).
+            uint8_t a[32];
+            memcpy(a, scalars[start + k].bytes, 32);
+            a[0] &= 248;
+            a[31] &= 127;
+            a[31] |= 64;
+
+            int8_t e[64];
+            for (int i = 0; i < 32; i++) {
+                e[2 * i] = a[i] & 15;
+                e[2 * i + 1] = (a[i] >> 4) & 15;
+            }
+            int8_t carry = 0;
+            for (int i = 0; i < 63; i++) {
+                e[i] += carry;
+                carry = (int8_t)((e[i] + 8) >> 4);
+                e[i] -= (int8_t)(carry << 4);
+            }
+            e[63] += carry;
+
+            ge_p3 R;
+            ge_identity(R);
+            for (size_t i = 0; i < WINDOWS; i++) {
+                ge_niels t;
+                select_entry(t, &table[i * ENTRIES], e[i]);
+                ge_madd(R, R, t);
+            }
+
+            // u = (1 + y) / (1 - y) = (Z + Y) / (Z - Y)
+            fe_add(num[k], R.Z, R.Y);
+            fe_sub(den[k], R.Z, R.Y);
+            crypto_wipe(a, sizeof(a));
+            crypto_wipe(e, sizeof(e));
+        }
+
+        // The identity gives den = 0, which inverts to 0 and yields u = 0,
+        // matching the ladder.
+        fe_batch_invert(den.data(), den.data(), count);
+        for (size_t k = 0; k < count; k++) {
+            fe_mul(num[k], num[k], den[k]);
+            out[start + k] = fe_to_bytes(num[k]);
+        }
+        crypto_wipe(num.data(), count * sizeof(fe25519));
+    });
+}
+
+const FixedBaseTable &FixedBaseTable::generator() {
+    static const FixedBaseTable table = [] {
+        uint256_t base = uint256_t();
+        base.bytes[0] = 9;
+        return FixedBaseTable(base);
+    }();
+    return table;
+}
+
+void x25519_fixed_base_batch(uint256_t *out, const uint256_t *scalars, const uint256_t &point,
+                             size_t n, size_t batch_size) {
+    FixedBaseTable table(point);
+    if (table.valid()) {
+        table.scalarmult_batch(out, scalars, n, batch_size);
+    } else {
+        x25519_batch(out, scalars, point, n, batch_size);
+    }
+}
@@ -4,33 +4,38 @@
 #include <random>
 #include <vector>
 #include <sstream>
-#include <NTL/ZZ_p.h>
-#include <NTL/ZZ_pX.h>
+#include <algorithm>
 #include "monocypher.hpp"
 #include "helpers.hpp"
+#include "field.hpp"
+#include "polynomial.hpp"
+#include "field_batch.hpp"
+#include "fixed_base.hpp"
+#include "blake2b_batch.hpp"
+#include "thread_pool.hpp"
+#include "drbg.hpp"
+#include "bin_table.hpp"
+#include "merkle.hpp"
 
 using namespace std;
-using namespace NTL;
+
+// Hashes per task in the batch hash helpers; small enough to spread a
+// 2^16-element phase over many cores, large enough to keep lanes full.
+static const size_t HASH_GRAIN = 1024;
 
 pair<vector<uint256_t>, vector<uint256_t>> gen_elligator_messages(size_t num_messages) {
     vector<uint256_t> messages(num_messages);
     vector<uint256_t> randomness(num_messages);
-    for (size_t i = 0; i < num_messages; i++) {
-        uint8_t b_i[32];
-        random_device rd;
-        for (size_t j = 0; j < 32; j++) {
-            b_i[j] = rd() & 0xFF;
+    ChaChaDrbg::local().fill(randomness.data(), num_messages);
+    // Compute g^b using the precomputed generator table
+    vector<uint256_t> g_b(num_messages);
+    FixedBaseTable::generator().scalarmult_batch(g_b.data(), randomness.data(), num_messages, X25519_BATCH_SIZE);
+    parallel_for(0, num_messages, HASH_GRAIN, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            // Elligator encoding
+            crypto_elligator_map(messages[i].bytes, g_b[i].bytes);
         }
-        // Compute g^b using X25519
-        uint8_t g_b[32];
-        crypto_x25519_public_key(g_b, b_i);
-        // Elligator encoding
-        uint8_t encoded[32];
-        crypto_elligator_map(encoded, g_b);
-
-        memcpy(&messages[i], encoded, 32);
-        memcpy(&randomness[i], b_i, 32);
-    }
+    });
     return make_pair(messages, randomness);
 }
 
@@ -41,6 +46,14 @@ size_t H_bin(const uint8_t hash[32], size_t bin_size) {
     return bin_index % bin_size;
 }
 
+void H_bin_batch(size_t* out, const uint256_t* hashes, size_t n, size_t bin_size) {
+    parallel_for(0, n, HASH_GRAIN, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            out[i] = H_bin(hashes[i].bytes, bin_size);
+        }
+    });
+}
+
 uint256_t H_2(const uint256_t& x_i, const uint256_t& k_i) {
     // Concatenate x_i and k_i
     uint8_t input[64];
@@ -53,32 +66,29 @@ uint256_t H_2(const uint256_t& x_i, const uint256_t& k_i) {
     return result;
 }
 
-ZZ bytes_to_ZZ(const uint256_t& num) {
-    ZZ result = ZZ(0);
-    ZZ base = ZZ(1);
-    
-    for (int i = 0; i < 32; i++) {
-        result += ZZ(num.bytes[i]) * base;
-        base *= 256;
-    }
-    
-    return result;
-}
-
-uint256_t ZZ_to_bytes(const ZZ& num) {
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    uint256_t result;
-    memset(result.bytes, 0, 32);
-
-    ZZ temp = num % prime;
-    if (temp < 0) temp += prime;
+// Throws if two x-coordinates coincide. Sorting the (canonical) limbs keeps
+// this O(n log n) instead of comparing every pair.
+static void check_distinct(const vector<fe25519>& xs) {
+    vector<size_t> order(xs.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
 
-    for (int i = 0; i < 32 && temp > 0; i++) {
-        result.bytes[i] = to_long(temp % 256);
-        temp /= 256;
+    auto limbs_less = [&xs](size_t a, size_t b) {
+        for (int k = 3; k >= 0; k--) {
+            if (xs[a].v[k] != xs[b].v[k]) return xs[a].v[k] < xs[b].v[k];
+        }
+        return a < b;
+    };
+    sort(order.begin(), order.end(), limbs_less);
+
+    for (size_t k = 1; k < order.size(); k++) {
+        size_t i = order[k - 1], j = order[k];
+        if (memcmp(xs[i].v, xs[j].v, sizeof(xs[i].v)) == 0) {
+            throw runtime_error(
+                "Duplicate x-coordinate detected at positions " + 
+                to_string(min(i, j)) + " and " + to_string(max(i, j))
+            );
+        }
     }
-
-    return result;
 }
 
 vector<uint256_t> Lagrange_Polynomial(vector<uint256_t> inputs,
@@ -92,40 +102,21 @@ vector<uint256_t> Lagrange_Polynomial(vector<uint256_t> inputs,
         throw runtime_error("Need at least 2 points for meaningful interpolation");
     }
     
-    // Prime field
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    ZZ_p::init(prime);
-    
-    vec_ZZ_p zp_inputs, zp_evals;
-    zp_inputs.SetLength(n);
-    zp_evals.SetLength(n);
-    
+    vector<fe25519> xs(n), ys(n);
     for (size_t i = 0; i < n; i++) {
-        ZZ temp_input = bytes_to_ZZ(inputs[i]) % prime;
-        if (temp_input < 0) temp_input += prime;
-        zp_inputs[i] = to_ZZ_p(temp_input);
-        
-        ZZ temp_eval = bytes_to_ZZ(evaluations[i]) % prime;
-        if (temp_eval < 0) temp_eval += prime;
-        zp_evals[i] = to_ZZ_p(temp_eval);
+        fe_canonical(xs[i], fe_from_bytes(inputs[i]));
+        ys[i] = fe_from_bytes(evaluations[i]);
     }
     
-    //check for duplicate x-coordinates
-    for (size_t i = 0; i < n; i++) {
-        for (size_t j = i + 1; j < n; j++) {
-            if (zp_inputs[i] == zp_inputs[j]) {
-                throw runtime_error(
-                    "Duplicate x-coordinate detected at positions " + 
-                    to_string(i) + " and " + to_string(j)
-                );
-            }
-        }
+    check_distinct(xs);
+
+    fe_poly P;
+    interpolate(P, xs.data(), ys.data(), n);
+
+    long degree = (long)n - 1;
+    while (degree >= 0 && fe_is_zero(P[degree])) {
+        degree--;
     }
-    //using ntl's interpolation
-    ZZ_pX P;
-    interpolate(P, zp_inputs, zp_evals);
-    
-    long degree = deg(P);
     // cout << "Polynomial degree: " << degree << endl;
     
     if (degree < 0) {
@@ -139,41 +130,43 @@ vector<uint256_t> Lagrange_Polynomial(vector<uint256_t> inputs,
     vector<uint256_t> result(degree + 1);
     
     for (long i = 0; i <= degree; i++) {
-        ZZ coeff_zz = rep(coeff(P, i));
-        result[i] = ZZ_to_bytes(coeff_zz);
+        result[i] = fe_to_bytes(P[i]);
     }
     
     // cout << "Generated polynomial with " << result.size() << " coefficients" << endl;
     return result;
 }
+
+static void print_hex(const uint256_t& x) {
+    for (int i = 31; i >= 0; i--) {
+        cout << hex << setw(2) << setfill('0') << (int)x.bytes[i];
+    }
+    cout << dec;
+}
+
 void test_interpolation_result(const vector<uint256_t>& coeffs,
                               const vector<uint256_t>& x,
                               const vector<uint256_t>& y) {
     // cout << "Testing result polynomial" << endl;
 
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    ZZ_p::init(prime);
-
-    ZZ_pX P;
-    for (size_t j = 0; j < coeffs.size(); j++) {
-        ZZ temp_coeff = bytes_to_ZZ(coeffs[j]);
-        SetCoeff(P, j, to_ZZ_p(temp_coeff));         
-    }
-
     for (size_t i = 0; i < x.size(); i++) {
-        ZZ temp_x = bytes_to_ZZ(x[i]);
-        ZZ_p zp_x = to_ZZ_p(temp_x);
-
-        ZZ_p res = eval(P, zp_x);                    
-        ZZ result_zz = rep(res);
-        uint256_t result = ZZ_to_bytes(result_zz);
+        uint256_t result = evaluate_poly(coeffs, x[i].bytes);
 
         if (memcmp(result.bytes, y[i].bytes, 32) != 0){
-            cout << "Error! x = " << bytes_to_ZZ(x[i]) 
-                << ", expected y = " << bytes_to_ZZ(y[i]) 
-                << ", got y = " << bytes_to_ZZ(result) << endl;
+            cout << "Error! x = "; print_hex(x[i]);
+            cout << ", expected y = "; print_hex(y[i]);
+            cout << ", got y = "; print_hex(result);
+            cout << endl;
             return;
         }
+#ifdef APSI_USE_NTL
+        uint256_t reference = evaluate_poly_NTL(coeffs, x[i].bytes);
+        if (memcmp(result.bytes, reference.bytes, 32) != 0) {
+            cout << "Error! native and NTL evaluations differ at x = "; print_hex(x[i]);
+            cout << endl;
+            return;
+        }
+#endif
     }
 
     cout << "Polynomial is interpolated correctly!" << endl;
@@ -188,103 +181,99 @@ uint256_t bytes_to_field(const uint8_t* bytes) {
 
 
 // Compute all n-th roots of unity in the field
-vector<ZZ_p> compute_roots_of_unity(size_t n) {
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    ZZ_p::init(prime);
-
+vector<fe25519> compute_roots_of_unity(size_t n) {
     // Find a generator g of the multiplicative group
-    ZZ_p g = ZZ_p(3);
-
-    // Compute g^((p-1)/n)
-    ZZ exp = (prime - 1) / n;
-    ZZ_p root = power(g, exp);
+    fe25519 g = fe_from_u64(3);
+
+    // Compute g^((p-1)/n), dividing p - 1 limb by limb from the top
+    const uint64_t p_minus_1[4] = {
+        0xffffffffffffffecULL, 0xffffffffffffffffULL,
+        0xffffffffffffffffULL, 0x7fffffffffffffffULL
+    };
+    uint64_t exp[4];
+    fe_u128 rem = 0;
+    for (int i = 3; i >= 0; i--) {
+        fe_u128 cur = (rem << 64) | p_minus_1[i];
+        exp[i] = (uint64_t)(cur / n);
+        rem = cur % n;
+    }
+    fe25519 root;
+    fe_pow(root, g, exp);
 
-    std::vector<ZZ_p> roots(n);
-    roots[0] = ZZ_p(1);
+    std::vector<fe25519> roots(n);
+    roots[0] = fe_one();
     for (size_t i = 1; i < n; ++i) {
-        roots[i] = roots[i-1] * root;
+        fe_mul(roots[i], roots[i-1], root);
     }
     return roots;
 }
 
-// Evaluate a polynomial (coeffs) at a field element (x)
-uint256_t eval_poly_coeffs(vector<uint256_t>& coeffs, const ZZ_p& x) {
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    ZZ_p::init(prime);
-    ZZ_pX P;
-    for (size_t i = 0; i < coeffs.size(); ++i) {
-        SetCoeff(P, i, to_ZZ_p(bytes_to_ZZ(coeffs[i]) % prime));
-    }
-    ZZ_p val = eval(P, x);
-    return ZZ_to_bytes(rep(val));
-}
-
-// Merkle root on evaluations at roots of unity
-uint256_t Merkle_Root_Receiver(vector<vector<uint256_t>> polys, size_t n) {
-    if (polys.empty() || n == 0) {
+// Merkle root on the evaluations over the selected commitment domain
+uint256_t Merkle_Root_Receiver(const BinTable& polys, size_t n, size_t arity, CommitDomain domain) {
+    if (polys.values.empty() || n == 0) {
         uint256_t zero;
         memset(zero.bytes, 0, 32);
         return zero;
     }
 
-    // 1. Compute all n-th roots of unity
-    std::vector<ZZ_p> roots = compute_roots_of_unity(n);
-
-    // 2. Evaluate polynomials at consecutive roots of unity
-    std::vector<uint256_t> merkle_leaves;
-    size_t root_idx = 0;
-    for (auto& poly : polys) {
-        size_t deg = poly.size();
-        for (size_t j = 0; j < deg; ++j) {
-            if (root_idx >= n) break;
-            uint256_t eval = eval_poly_coeffs(poly, roots[root_idx]);
-            // Hash the evaluation to get the leaf
-            uint256_t leaf_hash;
-            crypto_blake2b(leaf_hash.bytes, 32, eval.bytes, 32);
-            merkle_leaves.push_back(leaf_hash);
-            ++root_idx;
-        }
+    // 1. Compute all n-th roots of unity, unless the domain is 1 .. n
+    std::vector<fe25519> roots;
+    if (domain == CommitDomain::ROOTS_OF_UNITY) {
+        roots = compute_roots_of_unity(n);
+    }
+
+    // 2. Evaluate polynomials at consecutive domain points; polynomial i
+    // starts at point first_root[i]
+    std::vector<size_t> first_root(polys.num_bins() + 1, 0);
+    for (size_t i = 0; i < polys.num_bins(); i++) {
+        first_root[i + 1] = first_root[i] + std::min(polys.bin_size(i), n - first_root[i]);
     }
+    std::vector<uint256_t> merkle_leaves(first_root.back());
+    parallel_for(0, polys.num_bins(), 0, [&](size_t lo, size_t hi) {
+        std::vector<fe25519> evals;
+        for (size_t i = lo; i < hi; i++) {
+            size_t root_idx = first_root[i];
+            size_t count = first_root[i + 1] - root_idx;
+            if (count == 0) continue;
+            fe_poly coeffs = prepare_poly(polys.bin(i), polys.bin_size(i));
+            evals.resize(count);
+            if (domain == CommitDomain::PROGRESSION) {
+                fe_poly_eval_progression(evals.data(), coeffs.data(), coeffs.size(), root_idx + 1, count);
+            } else {
+                fe_poly_eval_batch(evals.data(), coeffs.data(), coeffs.size(), roots.data() + root_idx, count);
+            }
+            for (size_t j = 0; j < count; ++j) {
+                merkle_leaves[root_idx + j] = fe_to_bytes(evals[j]);
+            }
+        }
+    });
+    // Hash the evaluations to get the leaves
+    H_1_batch(merkle_leaves.data(), merkle_leaves.data(), merkle_leaves.size());
     // Safety check
     if (merkle_leaves.size() != n) {
         throw std::runtime_error("Total number of evaluations does not match n");
     }
 
-    // 3. Build Merkle tree as before
-    std::vector<uint256_t> current_level = merkle_leaves;
-    while (current_level.size() > 1) {
-        std::vector<uint256_t> next_level;
-        for (size_t i = 0; i < current_level.size(); i += 2) {
-            if (i + 1 < current_level.size()) {
-                next_level.push_back(H_2(current_level[i], current_level[i + 1]));
-            } else {
-                next_level.push_back(H_2(current_level[i], current_level[i]));
-            }
-        }
-        current_level = next_level;
+    // 3. Build the Merkle tree inside the leaf buffer
+    return merkle_root_in_place(merkle_leaves.data(), merkle_leaves.size(), arity);
+}
+
+vector<uint256_t> Merkle_Next_Level(const vector<uint256_t>& level) {
+    size_t pairs = level.size() / 2;
+    vector<uint256_t> next_level((level.size() + 1) / 2);
+    // Adjacent leaves are already laid out as 64-byte H_2 inputs
+    parallel_for(0, pairs, HASH_GRAIN, [&](size_t lo, size_t hi) {
+        blake2b_256_batch(next_level.data() + lo, level[2 * lo].bytes, 64, 64, hi - lo);
+    });
+    if (level.size() % 2 == 1) {
+        next_level[pairs] = H_2(level.back(), level.back());
     }
-    return current_level[0];
+    return next_level;
 }
 
 // Takes as input the merkle leaves and return the merkle root.
-uint256_t Merkle_Root_Sender(vector<uint256_t> merkle_leaves) {
-    vector<uint256_t> current_level = merkle_leaves;
-    
-    while (current_level.size() > 1) {
-        vector<uint256_t> next_level;
-        
-        for (size_t i = 0; i < current_level.size(); i += 2) {
-            if (i + 1 < current_level.size()) {
-                next_level.push_back(H_2(current_level[i], current_level[i + 1]));
-            } else {
-                next_level.push_back(H_2(current_level[i], current_level[i]));
-            }
-        }
-        
-        current_level = next_level;
-    }
-    
-    return current_level[0];
+uint256_t Merkle_Root_Sender(const vector<uint256_t>& merkle_leaves, size_t arity) {
+    return merkle_root(merkle_leaves.data(), merkle_leaves.size(), arity);
 }
 
 uint256_t evaluate_poly(const vector<uint256_t>& poly, const uint8_t* point_bytes) {
@@ -294,31 +283,14 @@ uint256_t evaluate_poly(const vector<uint256_t>& poly, const uint8_t* point_byte
         return zero;
     }
     
-    //same prime as lagrange 
-    ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
-    ZZ_p::init(prime);
-    
-    //reconstructing polynomial from coefficients
-    ZZ_pX P;
-    for (size_t i = 0; i < poly.size(); i++) {
-        ZZ coeff_zz = bytes_to_ZZ(poly[i]) % prime;
-        if (coeff_zz < 0) coeff_zz += prime;
-        SetCoeff(P, i, to_ZZ_p(coeff_zz));
+    //evaluate with Horner's rule directly on the limbs
+    fe25519 point = fe_from_bytes(point_bytes);
+    fe25519 acc = fe_from_bytes(poly.back());
+    for (size_t i = poly.size() - 1; i > 0; i--) {
+        fe_mul_add(acc, acc, point, fe_from_bytes(poly[i - 1]));
     }
     
-    //convert point_bytes to uint256_t first, then to ZZ
-    uint256_t point;
-    memcpy(point.bytes, point_bytes, 32);
-    
-    ZZ point_zz = bytes_to_ZZ(point) % prime;
-    if (point_zz < 0) point_zz += prime;
-    ZZ_p point_zp = to_ZZ_p(point_zz);
-    
-    //evaluate polynomial at the point
-    ZZ_p result_zp = eval(P, point_zp);
-    ZZ result_zz = rep(result_zp);
-    
-    return ZZ_to_bytes(result_zz);
+    return fe_to_bytes(acc);
 }
 
 // H_1 hash function for single input
@@ -337,4 +309,87 @@ uint256_t concatenate_and_hash(const uint256_t& a, const uint256_t& b) {
     uint256_t result;
     crypto_blake2b(result.bytes, sizeof(result.bytes), input, sizeof(input));
     return result;
-}
\ No newline at end of file
+}
+
+#ifdef APSI_USE_NTL
+static const ZZ& ntl_prime() {
+    static const ZZ prime = conv<ZZ>("57896044618658097711785492504343953926634992332820282019728792003956564819949");
+    return prime;
+}
+
+ZZ bytes_to_ZZ(const uint256_t& num) {
+    ZZ result;
+    ZZFromBytes(result, num.bytes, 32);
+    return result;
+}
+
+uint256_t ZZ_to_bytes(const ZZ& num) {
+    uint256_t result;
+    ZZ temp = num % ntl_prime();
+    if (temp < 0) temp += ntl_prime();
+    BytesFromZZ(result.bytes, temp, 32);
+    return result;
+}
+
+vector<uint256_t> Lagrange_Polynomial_NTL(const vector<uint256_t>& inputs,
+                                          const vector<uint256_t>& evaluations) {
+    size_t n = inputs.size();
+    ZZ_pPush push(ntl_prime());
+
+    vec_ZZ_p zp_inputs, zp_evals;
+    zp_inputs.SetLength(n);
+    zp_evals.SetLength(n);
+    for (size_t i = 0; i < n; i++) {
+        zp_inputs[i] = to_ZZ_p(bytes_to_ZZ(inputs[i]));
+        zp_evals[i] = to_ZZ_p(bytes_to_ZZ(evaluations[i]));
+    }
+
+    ZZ_pX P;
+    interpolate(P, zp_inputs, zp_evals);
+
+    vector<uint256_t> result(deg(P) + 1);
+    for (long i = 0; i <= deg(P); i++) {
+        result[i] = ZZ_to_bytes(rep(coeff(P, i)));
+    }
+    return result;
+}
+
+uint256_t evaluate_poly_NTL(const vector<uint256_t>& poly, const uint8_t* point_bytes) {
+    ZZ_pPush push(ntl_prime());
+
+    ZZ_pX P;
+    for (size_t i = 0; i < poly.size(); i++) {
+        SetCoeff(P, i, to_ZZ_p(bytes_to_ZZ(poly[i])));
+    }
+    uint256_t point;
+    memcpy(point.bytes, point_bytes, 32);
+
+    return ZZ_to_bytes(rep(eval(P, to_ZZ_p(bytes_to_ZZ(point)))));
+}
+#endif
+
+void H_1_batch(uint256_t* out, const uint256_t* x, size_t n) {
+    parallel_for(0, n, HASH_GRAIN, [&](size_t lo, size_t hi) {
+        blake2b_256_batch(out + lo, x[lo].bytes, 32, sizeof(uint256_t), hi - lo);
+    });
+}
+
+void H_2_batch(uint256_t* out, const uint256_t* x, const uint256_t* k, size_t n) {
+    concatenate_and_hash_batch(out, x, k, n);
+}
+
+void concatenate_and_hash_batch(uint256_t* out, const uint256_t* a, const uint256_t* b, size_t n) {
+    // Concatenate a chunk at a time so the scratch buffer stays in cache
+    const size_t chunk = 256;
+    parallel_for(0, n, HASH_GRAIN, [&](size_t lo, size_t hi) {
+        uint8_t input[chunk * 64];
+        for (size_t start = lo; start < hi; start += chunk) {
+            size_t count = min(chunk, hi - start);
+            for (size_t i = 0; i < count; i++) {
+                memcpy(input + 64 * i, a[start + i].bytes, 32);
+                memcpy(input + 64 * i + 32, b[start + i].bytes, 32);
+            }
+            blake2b_256_batch(out + start, input, 64, 64, count);
+        }
+    });
+}
@@ -6,7 +6,6 @@
 #include <cstddef>
 #include <cstdint>
 #include <cmath>
-#include <unordered_set>
 #include <algorithm> 
 #include <atomic>
 #include <thread>
@@ -17,134 +16,288 @@
 #include "sender.hpp"
 #include "receiver.hpp"
 #include "intersect.hpp"
+#include "polynomial.hpp"
+#include "x25519_batch.hpp"
+#include "fixed_base.hpp"
+#include "thread_pool.hpp"
+#include "drbg.hpp"
+#include "digest_set.hpp"
+#include "bin_table.hpp"
+#include "field_batch.hpp"
 
 using namespace std;
 
+// Evaluates polys[b] at points[i] for every i in members.bin(b), decoding
+// each polynomial once per bin. Returns the evaluations indexed like points,
+// left in field form for the next kernel.
+static FieldBatch evaluate_bins(const BinTable& polys,
+                                const BinPartition& members,
+                                const vector<uint256_t>& points) {
+    FieldBatch result(points.size());
+    parallel_for(0, members.num_bins(), 0, [&](size_t lo, size_t hi) {
+        vector<fe25519> xs, ys;
+        for (size_t b = lo; b < hi; b++) {
+            size_t count = members.bin_size(b);
+            if (count == 0) continue;
+            const size_t* member = members.bin(b);
+
+            fe_poly poly = prepare_poly(polys.bin(b), polys.bin_size(b));
+            xs.resize(count);
+            ys.resize(count);
+            for (size_t k = 0; k < count; k++) {
+                xs[k] = fe_from_bytes(points[member[k]]);
+            }
+            multipoint_eval(ys.data(), poly, xs.data(), count);
+            for (size_t k = 0; k < count; k++) {
+                result.set(member[k], ys[k]);
+            }
+        }
+    });
+    return result;
+}
+
+// Fixed-degree counterpart of evaluate_bins(): the first uniform_bins
+// polynomials share one length, so the points need no grouping and go
+// through the lockstep kernel in input order. Points of a later bin (the
+// sender's stash) fall back to Horner.
+static FieldBatch evaluate_fixed_bins(const BinTable& polys, size_t uniform_bins,
+                                      const size_t* bins,
+                                      const vector<uint256_t>& points) {
+    size_t ncoeffs = uniform_bins != 0 ? polys.bin_size(0) : 0;
+    vector<fe25519> coeffs(uniform_bins * ncoeffs);
+    parallel_for(0, coeffs.size(), 0, [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; k++) {
+            coeffs[k] = fe_from_bytes(polys.values[k]);
+        }
+    });
+
+    FieldBatch result(points.size());
+    parallel_for(0, points.size(), 0, [&](size_t lo, size_t hi) {
+        size_t count = hi - lo;
+        vector<fe25519> xs(count), ys(count);
+        vector<size_t> which(count);
+        for (size_t k = 0; k < count; k++) {
+            xs[k] = fe_from_bytes(points[lo + k]);
+            which[k] = bins[lo + k] < uniform_bins ? bins[lo + k] : 0;
+        }
+        fe_poly_eval_lockstep(ys.data(), coeffs.data(), ncoeffs, which.data(), xs.data(), count);
+        for (size_t k = 0; k < count; k++) {
+            size_t b = bins[lo + k];
+            if (b >= uniform_bins) {
+                ys[k] = poly_eval(prepare_poly(polys.bin(b), polys.bin_size(b)), xs[k]);
+            }
+            result.set(lo + k, ys[k]);
+        }
+    });
+    return result;
+}
+
+static void send_message(NetworkSimulator& net, const string& str, bool client_to_server) {
+    if (client_to_server) {
+        net.sendClientToServer(str);
+    } else {
+        net.sendServerToClient(str);
+    }
+}
+
+// Sends count values as one message, straight from their buffer.
+static void send_values(NetworkSimulator& net, const uint256_t* values, size_t count,
+                        bool client_to_server) {
+    send_message(net, string(reinterpret_cast<const char*>(values), 32 * count), client_to_server);
+}
+
+// Sends the whole table as one message: a directory of 4-byte little-endian
+// bin sizes followed by every bin's coefficients back to back. One message
+// pays the link latency once instead of once per bin.
+static void send_bins(NetworkSimulator& net, const BinTable& bins, bool client_to_server) {
+    size_t num_bins = bins.num_bins();
+    string str(4 * num_bins + 32 * bins.values.size(), '\0');
+    for (size_t b = 0; b < num_bins; b++) {
+        uint32_t size = (uint32_t)bins.bin_size(b);
+        for (size_t j = 0; j < 4; j++) {
+            str[4 * b + j] = (char)(size >> (8 * j));
+        }
+    }
+    if (!bins.values.empty()) {
+        memcpy(&str[4 * num_bins], bins.values.data(), 32 * bins.values.size());
+    }
+    send_message(net, str, client_to_server);
+}
+
+// Fixed-degree wire format: the first uniform_bins bins all have the same
+// length, so they go out as one message and the receiving side splits it by
+// the public bin count. Any later bin is sent on its own as before.
+static void send_fixed_bins(NetworkSimulator& net, const BinTable& bins, size_t uniform_bins,
+                            bool client_to_server) {
+    send_values(net, bins.values.data(), bins.bin_offsets[uniform_bins], client_to_server);
+    for (size_t b = uniform_bins; b < bins.num_bins(); b++) {
+        send_values(net, bins.bin(b), bins.bin_size(b), client_to_server);
+    }
+}
 
 vector<uint256_t> intersect(Receiver &receiver, Sender &sender, NetworkSimulator &net) {
     auto intersection_start = chrono::high_resolution_clock::now();
     
     // 1. Receiver sends polynomials to the sender
-    printf("Receiver sends %zu polynomials to the sender.\n", receiver.polys.size());
+    const BinConfig& config = receiver.bin_config;
+    size_t bin_size = receiver.input_len / log2(receiver.input_len);
+    printf("Receiver sends %zu polynomials to the sender.\n", receiver.polys.num_bins());
     auto send_start = chrono::high_resolution_clock::now();
-    for (const auto& poly : receiver.polys) {
-        for (const auto& coeff : poly) {
-            string coeff_str(reinterpret_cast<const char*>(coeff.bytes), 32);
-            net.sendClientToServer(coeff_str);
-        }
+    if (config.fixed_degree) {
+        send_fixed_bins(net, receiver.polys, min(bin_size, receiver.polys.num_bins()), true);
+    } else {
+        send_bins(net, receiver.polys, true);
     }
     auto send_end = chrono::high_resolution_clock::now();
     auto rec_send_duration = chrono::duration_cast<chrono::microseconds>(send_end - send_start);
     
     // 2. Sender aborts if any(deg(receiver's poly)) < 1 or the Merkle root does not match
     auto sender_start = chrono::high_resolution_clock::now();
-    for (const auto& poly : receiver.polys) {
-        if (poly.size() < 2) {
+    // (an empty bin carries no polynomial at all)
+    for (size_t b = 0; b < receiver.polys.num_bins(); b++) {
+        if (receiver.polys.bin_size(b) == 1) {
             throw runtime_error("Sender aborts: Polynomial degree < 1");
         }
     }
     
     // check if merkle root created using receiver.polys matches with receiver.merkle_root
-    uint256_t computed_root = Merkle_Root_Receiver(receiver.polys, receiver.input_len);
+    if (sender.merkle_arity != receiver.merkle_arity) {
+        throw runtime_error("Sender aborts: parties use different Merkle arities");
+    }
+    uint256_t computed_root = Merkle_Root_Receiver(receiver.polys, receiver.polys.values.size(),
+                                                   receiver.merkle_arity, receiver.commit_domain);
     if (!(computed_root == receiver.merkle_root)) {
         throw runtime_error("Sender aborts: Merkle root does not match");
     }
     printf("Receiver's input is valid. Sender proceeds.\n");
 
-    // 3. Sender computes the number of receiver elements
-    size_t num_receiver_elements = 0;
-    for (const auto& poly : receiver.polys) {
-        num_receiver_elements += poly.size();
-    }
-    if (num_receiver_elements != receiver.input_len) {
-        throw runtime_error("Sender aborts: Number of receiver elements does not match");
+    // 3. Sender computes the number of receiver elements. Dummies only exist
+    // outside the simple unpadded scheme; there the bin layout is checked
+    // instead.
+    bool stash = config.strategy == BinStrategy::CUCKOO;
+    size_t num_receiver_elements = receiver.polys.values.size();
+    if (config.strategy == BinStrategy::SIMPLE && !config.pad && !config.fixed_degree) {
+        if (num_receiver_elements != receiver.input_len) {
+            throw runtime_error("Sender aborts: Number of receiver elements does not match");
+        }
+    } else {
+        if (num_receiver_elements < receiver.input_len ||
+            receiver.polys.num_bins() != bin_size + (stash ? 1 : 0)) {
+            throw runtime_error("Sender aborts: Number of receiver elements does not match");
+        }
+        // Padded regular bins must all match; a stash is empty or holds
+        // exactly CUCKOO_STASH_SIZE points
+        size_t uniform_bins = config.pad || config.fixed_degree ? bin_size : 0;
+        size_t stash_size = stash ? receiver.polys.bin_size(bin_size) : 0;
+        if (uniform_bins != 0 && stash_size != 0 && stash_size != CUCKOO_STASH_SIZE) {
+            throw runtime_error("Sender aborts: Stash is not padded");
+        }
+        for (size_t b = 1; b < uniform_bins; b++) {
+            if (receiver.polys.bin_size(b) != receiver.polys.bin_size(0)) {
+                throw runtime_error("Sender aborts: Bins are not padded");
+            }
+        }
     }
     
     // Generate sender's KA values
     uint256_t a = uint256_t();
-    random_device rd;
-    for (size_t j = 0; j < 32; j++) {
-        a.bytes[j] = rd() & 0xFF;
-    }
-    uint8_t g_a[32];
-    crypto_x25519_public_key(g_a, a.bytes);
+    ChaChaDrbg::local().fill(&a, 1);
     uint256_t m_sender = uint256_t();
-    memcpy(m_sender.bytes, g_a, 32);
+    FixedBaseTable::generator().scalarmult_batch(&m_sender, &a, 1);
 
     // 4. Sender processes each input
-    size_t bin_size = num_receiver_elements / log2(num_receiver_elements);
-    vector<vector<uint256_t>> T_Sender(bin_size);
     vector<uint256_t> k_values;
-    k_values.reserve(sender.input_len);
-    
-    for (size_t idx = 0; idx < sender.input_len; idx++) {
-        const auto& message = sender.input[idx];
-        
-        // Get bin index using H_1(message)
-        uint256_t h1_message = H_1(message);
-        uint8_t hash[32];
-        crypto_blake2b(hash, sizeof(hash), h1_message.bytes, 32);
-        size_t bin_index = H_bin(hash, bin_size);
-        
-        // Find the corresponding polynomial
-        if (bin_index >= receiver.polys.size()) {
-            throw runtime_error("Bin index out of range");
+    
+    // Every bin must have its polynomial
+    if (bin_size + (stash ? 1 : 0) > receiver.polys.num_bins()) {
+        throw runtime_error("Bin index out of range");
+    }
+    // The sender cannot know which candidate bin the receiver picked for a
+    // shared element, so it works on (element, candidate bin) pairs; a used
+    // stash is one more candidate of every element, and then costs a sender
+    // polynomial through all sen_sz points. Padding never fills an empty
+    // stash, so only a receiver that stashed something pays for it. H_1 and
+    // the bin hashes were cached by Sender::commit().
+    bool with_stash = stash && !receiver.polys.bin_empty(bin_size);
+    size_t per_element = 1;
+    vector<size_t> pair_bins = candidate_pairs(sender.digests, bin_size, config.strategy,
+                                               with_stash, per_element);
+    size_t num_pairs = pair_bins.size();
+    size_t total_bins = receiver.polys.num_bins();
+    BinPartition bin_members = partition_bins(pair_bins.data(), num_pairs, total_bins);
+    vector<uint256_t> h1_pairs(num_pairs), x_pairs(num_pairs), r_pairs(num_pairs);
+    parallel_for(0, num_pairs, 0, [&](size_t lo, size_t hi) {
+        for (size_t p = lo; p < hi; p++) {
+            h1_pairs[p] = sender.digests.h1[p / per_element];
+            x_pairs[p] = sender.input[p / per_element];
+            r_pairs[p] = sender.random_values[p / per_element];
         }
-        
-        // Evaluate polynomial at H_1(message)
-        uint256_t poly_eval = evaluate_poly(receiver.polys[bin_index], h1_message.bytes);
-        
-        // Compute shared key
-        uint256_t shared_key;
-        crypto_x25519(shared_key.bytes, a.bytes, poly_eval.bytes);
-        uint256_t k_i;
-        crypto_blake2b(k_i.bytes, sizeof(k_i.bytes), shared_key.bytes, sizeof(shared_key.bytes));
-        
-        k_values.push_back(k_i);
-        T_Sender[bin_index].push_back(message);
-    }
-
-    // 5. Sender computes P_j polynomials for each bin
-    vector<vector<uint256_t>> P_Sender(bin_size);
-    size_t k_i_counter = 0;
-    for (size_t i = 0; i < T_Sender.size(); ++i) {
-        if (T_Sender[i].size() == 1) {
-            // Find the next bin with at least 1 element (not itself)
-            size_t j = (i + 1) % T_Sender.size();
-            while (j != i && T_Sender[j].empty()) {
-                j = (j + 1) % T_Sender.size();
+    });
+    
+    // Evaluate each bin polynomial at H_1(message) for all messages in the bin
+    FieldBatch poly_evals = config.fixed_degree
+        ? evaluate_fixed_bins(receiver.polys, bin_size, pair_bins.data(), h1_pairs)
+        : evaluate_bins(receiver.polys, bin_members, h1_pairs);
+    
+    // Compute shared keys, all with the same scalar a
+    vector<uint256_t> shared_keys(num_pairs);
+    x25519_batch(shared_keys.data(), a, poly_evals, X25519_BATCH_SIZE);
+    
+    k_values.resize(num_pairs);
+    H_1_batch(k_values.data(), shared_keys.data(), num_pairs);
+
+    // 5. Sender computes P_j polynomials for each bin. Rebalancing moves
+    // pair indices, and x, k and r are gathered through them afterwards, so
+    // every element keeps its own key and random value. Padded bins never
+    // hold a lone element, so they are not rebalanced.
+    bool pad = config.pad || config.fixed_degree;
+    BinPartition sender_bins = pad ? bin_members : rebalance_singletons(bin_members);
+    BinTable T_Sender = gather_bins(x_pairs.data(), sender_bins);
+    BinTable K_Sender = gather_bins(k_values.data(), sender_bins);
+    BinTable R_Sender = gather_bins(r_pairs.data(), sender_bins);
+    // Padding covers the regular bins only: the stash bin holds every
+    // element, so its length is public anyway and it is left as is (padding
+    // the regular bins to it would cost O(bins * n)). Fixed-degree mode pads
+    // them to the public bound for per_element pairs of every element.
+    size_t padded_load = 2;
+    size_t padded_bins = bin_size;
+    if (config.fixed_degree) {
+        size_t regular_pairs = sender.input_len * (per_element - (with_stash ? 1 : 0));
+        padded_load = fixed_bin_load(regular_pairs, bin_size, BinStrategy::SIMPLE);
+    }
+    for (size_t b = 0; pad && b < padded_bins; b++) {
+        padded_load = max(padded_load, T_Sender.bin_size(b));
+    }
+    vector<vector<uint256_t>> sender_polys(total_bins);
+    parallel_for(0, total_bins, 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            size_t count = T_Sender.bin_size(i);
+            if (count == 0 && !(pad && i < padded_bins)) {
+                continue;
+            }
+
+            vector<uint256_t> H_2_values(count);
+            H_2_batch(H_2_values.data(), T_Sender.bin(i), K_Sender.bin(i), count);
+            vector<uint256_t> r_values(R_Sender.bin(i), R_Sender.bin(i) + count);
+            if (pad && i < padded_bins) {
+                pad_with_dummies(H_2_values, r_values, padded_load);
+            }
+
+            sender_polys[i] = Lagrange_Polynomial(H_2_values, r_values);
+            if (config.fixed_degree && i < padded_bins) {
+                sender_polys[i].resize(max(sender_polys[i].size(), padded_load), uint256_t());
             }
-            // Move the element
-            T_Sender[j].push_back(T_Sender[i][0]);
-            T_Sender[i].clear();
-        }
-    }   
-    for (size_t i = 0; i < bin_size; i++) {
-        if (T_Sender[i].empty()) {
-            continue;
-        }
-        
-        vector<uint256_t> H_2_values;
-        vector<uint256_t> r_values;
-        
-        for (size_t j = 0; j < T_Sender[i].size(); j++) {
-            uint256_t k_i = k_values[k_i_counter];
-            H_2_values.push_back(H_2(T_Sender[i][j], k_i));
-            r_values.push_back(sender.random_values[k_i_counter]);
-            k_i_counter++;
         }
-        
-        P_Sender[i] = Lagrange_Polynomial(H_2_values, r_values);
-    }
+    });
+    BinTable P_Sender = flatten_bins(sender_polys);
     
-    printf("Sender sends %zu polynomials, m, and D' to the receiver.\n", P_Sender.size());
+    printf("Sender sends %zu polynomials, m, and D' to the receiver.\n", P_Sender.num_bins());
     
     // Send polynomials
-    for (const auto& poly : P_Sender) {
-        for (const auto& coeff : poly) {
-            string coeff_str(reinterpret_cast<const char*>(coeff.bytes), 32);
-            net.sendServerToClient(coeff_str);
-        }
+    if (config.fixed_degree) {
+        send_fixed_bins(net, P_Sender, bin_size, false);
+    } else {
+        send_bins(net, P_Sender, false);
     }
     
     // Send m_sender
@@ -162,43 +315,47 @@ vector<uint256_t> intersect(Receiver &receiver, Sender &sender, NetworkSimulator
     auto receiver_start2 = chrono::high_resolution_clock::now();
     
     // Verify sender's merkle root
-    if (!(sender.merkle_root == Merkle_Root_Sender(sender.merkle_leaves))) {
+    if (!(sender.merkle_root == Merkle_Root_Sender(sender.merkle_leaves, receiver.merkle_arity))) {
         throw runtime_error("Receiver aborts: Merkle root does not match");
     }
     printf("Sender's input is valid. Receiver proceeds.\n");
 
-    vector<uint256_t> R_intersection;
-    for (size_t i = 0; i < receiver.input_len; i++) {
-        // Get bin index using H_1(input)
-        uint256_t h1_input = H_1(receiver.input[i]);
-        uint8_t hash[32];
-        crypto_blake2b(hash, sizeof(hash), h1_input.bytes, 32);
-        size_t bin_index = H_bin(hash, bin_size);
-        
-        // Compute shared key using receiver's randomness
-        uint256_t b_i = receiver.randomness[i];
-        uint256_t shared_key;
-        crypto_x25519(shared_key.bytes, b_i.bytes, m_sender.bytes);
-        uint256_t k_i_receiver;
-        crypto_blake2b(k_i_receiver.bytes, sizeof(k_i_receiver.bytes), shared_key.bytes, sizeof(shared_key.bytes));
-        
-        // Evaluate sender's polynomial
-        uint256_t h2_input_key = H_2(receiver.input[i], k_i_receiver);
-        uint256_t r_i_receiver = evaluate_poly(P_Sender[bin_index], h2_input_key.bytes);
-        
-        // Compute the final value for intersection check
-        uint256_t final_val = concatenate_and_hash(receiver.input[i], r_i_receiver);
-        R_intersection.push_back(final_val);
+    // Compute shared keys using receiver's randomness, all against m_sender
+    // through a comb table built once for this session
+    vector<uint256_t> receiver_shared_keys(receiver.input_len);
+    x25519_fixed_base_batch(receiver_shared_keys.data(), receiver.randomness.data(), m_sender, receiver.input_len, X25519_BATCH_SIZE);
+    
+    // Keys k_i = H(shared_key_i), four lanes at a time
+    vector<uint256_t> k_i_receiver(receiver.input_len);
+    H_1_batch(k_i_receiver.data(), receiver_shared_keys.data(), receiver.input_len);
+
+    vector<uint256_t> h2_input_keys(receiver.input_len);
+    H_2_batch(h2_input_keys.data(), receiver.input.data(), k_i_receiver.data(), receiver.input_len);
+    // Bins from the receiver's commit; only a different bin count re-places them
+    if (receiver.digests.num_bins != bin_size) {
+        receiver.digests.assign_bins(bin_size, config.strategy);
     }
+    const BinPartition& receiver_bin_members = receiver.digests.partition;
+    
+    // Evaluate sender's polynomials, one batch per bin
+    vector<uint256_t> r_values_receiver = (config.fixed_degree
+        ? evaluate_fixed_bins(P_Sender, bin_size, receiver.digests.bins.data(), h2_input_keys)
+        : evaluate_bins(P_Sender, receiver_bin_members, h2_input_keys)).to_bytes();
+    
+    // Compute the final values for the intersection check
+    vector<uint256_t> R_intersection(receiver.input_len);
+    concatenate_and_hash_batch(R_intersection.data(), receiver.input.data(), r_values_receiver.data(), receiver.input_len);
 
     // Find intersection
-    unordered_set<uint256_t> merkle_set(sender.merkle_leaves.begin(), sender.merkle_leaves.end());
+    DigestSet merkle_set(sender.merkle_leaves.data(), sender.merkle_leaves.size());
+    vector<uint8_t> found(R_intersection.size());
+    merkle_set.contains_batch(found.data(), R_intersection.data(), R_intersection.size());
     vector<uint256_t> intersection;
     intersection.reserve(min(R_intersection.size(), sender.merkle_leaves.size()));
     
-    for (const auto& item : R_intersection) {
-        if (merkle_set.count(item)) {
-            intersection.push_back(item);
+    for (size_t i = 0; i < R_intersection.size(); i++) {
+        if (found[i]) {
+            intersection.push_back(R_intersection[i]);
         }
     }
     
@@ -17,14 +17,19 @@
 #include "sender.hpp"
 #include "receiver.hpp"
 #include "intersect.hpp"
+#include "thread_pool.hpp"
+#include "drbg.hpp"
+#include "bin_table.hpp"
 
 using namespace std;
 
 int parse_args(int argc, char *argv[], 
-    size_t &rec_sz, size_t &sen_sz, string &mode){
+    size_t &rec_sz, size_t &sen_sz, string &mode, size_t &threads,
+    bool &seeded, uint64_t &seed, BinConfig &bin_config, size_t &merkle_arity,
+    CommitDomain &commit_domain, string &merkle_tree_path){
     if (argc < 3) {
-        printf("Usage: %s <receiver_size> <sender_size> [--mode lan|wan]\n", argv[0]);
-        printf("Example: %s 1000 1000 --mode wan\n", argv[0]);
+        printf("Usage: %s <receiver_size> <sender_size> [--mode lan|wan] [--threads N] [--seed S] [--bins simple|two-choice|cuckoo] [--pad] [--fixed-degree] [--merkle-arity 2|4|8] [--commit-domain roots|progression] [--merkle-tree PATH]\n", argv[0]);
+        printf("Example: %s 1000 1000 --mode wan --threads 8\n", argv[0]);
         return 1;
     }
 
@@ -37,6 +42,46 @@ int parse_args(int argc, char *argv[],
         std::string arg = argv[i];
         if (arg == "--mode" && i + 1 < argc) {
             mode = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]); // 0 keeps one thread per core
+        } else if (arg == "--seed" && i + 1 < argc) {
+            // Reproducible inputs and randomness, for benchmarking only
+            seed = strtoull(argv[++i], nullptr, 10);
+            seeded = true;
+        } else if (arg == "--bins" && i + 1 < argc) {
+            std::string strategy = argv[++i];
+            if (strategy == "simple") {
+                bin_config.strategy = BinStrategy::SIMPLE;
+            } else if (strategy == "two-choice") {
+                bin_config.strategy = BinStrategy::TWO_CHOICE;
+            } else if (strategy == "cuckoo") {
+                bin_config.strategy = BinStrategy::CUCKOO;
+            } else {
+                printf("Unknown bin strategy: %s\n", strategy.c_str());
+                return 1;
+            }
+        } else if (arg == "--pad") {
+            bin_config.pad = true;
+        } else if (arg == "--fixed-degree") {
+            bin_config.fixed_degree = true;
+        } else if (arg == "--merkle-arity" && i + 1 < argc) {
+            merkle_arity = atoi(argv[++i]);
+            if (merkle_arity != 2 && merkle_arity != 4 && merkle_arity != 8) {
+                printf("Merkle arity must be 2, 4 or 8\n");
+                return 1;
+            }
+        } else if (arg == "--commit-domain" && i + 1 < argc) {
+            std::string domain = argv[++i];
+            if (domain == "roots") {
+                commit_domain = CommitDomain::ROOTS_OF_UNITY;
+            } else if (domain == "progression") {
+                commit_domain = CommitDomain::PROGRESSION;
+            } else {
+                printf("Unknown commitment domain: %s\n", domain.c_str());
+                return 1;
+            }
+        } else if (arg == "--merkle-tree" && i + 1 < argc) {
+            merkle_tree_path = argv[++i];
         }
     }
 
@@ -48,36 +93,34 @@ int main(int argc, char *argv[]) {
 
     size_t rec_sz, sen_sz;
     string mode = "lan";
+    size_t threads = 0;
+    bool seeded = false;
+    uint64_t seed = 0;
+    BinConfig bin_config;
+    size_t merkle_arity = 2;
+    CommitDomain commit_domain = CommitDomain::ROOTS_OF_UNITY;
+    string merkle_tree_path;
     
     // Parse Arguments
-    if(parse_args(argc, argv, rec_sz, sen_sz, mode)){
+    if(parse_args(argc, argv, rec_sz, sen_sz, mode, threads, seeded, seed, bin_config, merkle_arity, commit_domain, merkle_tree_path)){
         return 1;
     }
+    ThreadPool::set_default_threads(threads);
+    if (seeded) {
+        ChaChaDrbg::set_seed(seed);
+    }
     
-    random_device rd;
     vector<uint256_t> receiver_input(rec_sz);
     vector<uint256_t> sender_input(sen_sz);
     
-    
-    
     // Generate receiver input
-    for (size_t i = 0; i < rec_sz; i++) {
-        for (size_t j = 0; j < 32; j++) {
-            receiver_input[i].bytes[j] = rd() & 0xFF;
-        }
-    }
+    ChaChaDrbg::local().fill(receiver_input.data(), rec_sz);
     
     // Generate sender input (with some overlap for testing)
-    for (size_t i = 0; i < sen_sz; i++) {
-        if (i < rec_sz / 2) {
-            // First half overlaps with receiver
-            sender_input[i] = receiver_input[i];
-        } else {
-            // Second half is different
-            for (size_t j = 0; j < 32; j++) {
-                sender_input[i].bytes[j] = rd() & 0xFF; 
-            }
-        }
+    ChaChaDrbg::local().fill(sender_input.data(), sen_sz);
+    for (size_t i = 0; i < sen_sz && i < rec_sz / 2; i++) {
+        // First half overlaps with receiver
+        sender_input[i] = receiver_input[i];
     }
     
     // Network configuration
@@ -95,11 +138,17 @@ int main(int argc, char *argv[]) {
 
     printf("Receiver size: %zu, Sender size: %zu\n", rec_sz, sen_sz);
     printf("Network mode: %s\n", mode.c_str());
+    printf("Threads: %zu\n", ThreadPool::instance().size());
     NetworkSimulator net(lat_cs, lat_sc, bw_kbps);
     
     // Create instances with different inputs
     Receiver receiver(receiver_input.data(), rec_sz);
+    receiver.bin_config = bin_config;
+    receiver.merkle_arity = merkle_arity;
+    receiver.commit_domain = commit_domain;
     Sender sender(sender_input.data(), sen_sz);
+    sender.merkle_arity = merkle_arity;
+    sender.merkle_tree_path = merkle_tree_path;
     
     // Both parties commit
     receiver.commit();
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "merkle.hpp"
+#include "blake2b_batch.hpp"
+#include "thread_pool.hpp"
+
+void check_merkle_arity(size_t arity) {
+    if (arity != 2 && arity != 4 && arity != 8) {
+        throw std::runtime_error("Merkle arity must be 2, 4 or 8");
+    }
+}
+
+// Hash of the arity nodes at children, stored back to back.
+static uint256_t merkle_node(const uint256_t *children, size_t arity) {
+    uint256_t out;
+    crypto_blake2b(out.bytes, 32, children[0].bytes, 32 * arity);
+    return out;
+}
+
+// Replaces the m nodes at in by their parent level, written to out (which
+// may be in itself), and returns the parent count. Sibling groups are
+// already laid out as hash inputs.
+static size_t merkle_level(uint256_t *out, const uint256_t *in, size_t m, size_t arity) {
+    size_t groups = m / arity;
+    blake2b_256_batch(out, in[0].bytes, 32 * arity, 32 * arity, groups);
+    if (m % arity != 0) {
+        uint256_t last[8];
+        size_t k = 0;
+        for (; k < m % arity; k++) last[k] = in[groups * arity + k];
+        for (; k < arity; k++) last[k] = in[m - 1];
+        out[groups] = merkle_node(last, arity);
+    }
+    return groups + (m % arity != 0);
+}
+
+// Reduces the m <= MERKLE_BLOCK_LEAVES nodes at in to the root of their
+// block, using out as the working buffer (out may be in). A block that is
+// not the whole tree always climbs all the way to the block level, so a
+// short last block keeps padding with its last node like the full tree does.
+static uint256_t merkle_block(uint256_t *out, const uint256_t *in, size_t m, size_t arity,
+                              bool whole_tree) {
+    size_t width = MERKLE_BLOCK_LEAVES;
+    while (whole_tree ? m > 1 : width > 1) {
+        m = merkle_level(out, in, m, arity);
+        in = out;
+        width /= arity;
+    }
+    return in[0];
+}
+
+// Half a block per thread, for blocks that must not overwrite their
+// leaves; the first level reads the leaves and writes here.
+static uint256_t *merkle_scratch() {
+    thread_local std::vector<uint256_t> buffer(MERKLE_BLOCK_LEAVES / 2);
+    return buffer.data();
+}
+
+// Block roots in parallel, then the top levels over them. Blocks are
+// reduced inside work (which may be leaves) or, without it, in scratch.
+static uint256_t merkle_root_blocked(const uint256_t *leaves, uint256_t *work, size_t n,
+                                     size_t arity) {
+    check_merkle_arity(arity);
+    if (n == 0) {
+        uint256_t zero;
+        memset(zero.bytes, 0, 32);
+        return zero;
+    }
+    size_t num_blocks = (n + MERKLE_BLOCK_LEAVES - 1) / MERKLE_BLOCK_LEAVES;
+    std::vector<uint256_t> roots(num_blocks);
+    parallel_for(0, num_blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            size_t first = b * MERKLE_BLOCK_LEAVES;
+            size_t m = std::min(n - first, MERKLE_BLOCK_LEAVES);
+            uint256_t *out = work != nullptr ? work + first : merkle_scratch();
+            roots[b] = merkle_block(out, leaves + first, m, arity, num_blocks == 1);
+        }
+    });
+    size_t m = num_blocks;
+    while (m > 1) {
+        m = merkle_level(roots.data(), roots.data(), m, arity);
+    }
+    return roots[0];
+}
+
+uint256_t merkle_root(const uint256_t *leaves, size_t n, size_t arity) {
+    return merkle_root_blocked(leaves, nullptr, n, arity);
+}
+
+uint256_t merkle_root_in_place(uint256_t *leaves, size_t n, size_t arity) {
+    return merkle_root_blocked(leaves, leaves, n, arity);
+}
+
+MerkleAccumulator::MerkleAccumulator(size_t arity) : arity(arity), count(0) {
+    check_merkle_arity(arity);
+}
+
+// Level l keeps its pending nodes in frontier[l * arity ..], in order; the
+// slot after them takes the node that completes the group.
+void MerkleAccumulator::push(uint256_t node, size_t level) {
+    size_t added = 1;
+    for (size_t l = 0; l < level; l++) added *= arity;
+    size_t l = level, unit = added;
+    size_t digit = (count / unit) % arity;
+    while (digit == arity - 1) {
+        frontier[l * arity + digit] = node;
+        node = merkle_node(&frontier[l * arity], arity);
+        l++;
+        unit *= arity;
+        digit = (count / unit) % arity;
+    }
+    if (frontier.size() < (l + 1) * arity) frontier.resize((l + 1) * arity);
+    frontier[l * arity + digit] = node;
+    count += added;
+}
+
+void MerkleAccumulator::add(const uint256_t &leaf) {
+    push(leaf, 0);
+}
+
+void MerkleAccumulator::add(const uint256_t *leaves, size_t n) {
+    // Leaf by leaf up to a block boundary, then whole blocks
+    while (n > 0 && count % MERKLE_BLOCK_LEAVES != 0) {
+        add(*leaves++);
+        n--;
+    }
+    size_t num_blocks = n / MERKLE_BLOCK_LEAVES;
+    if (num_blocks != 0) {
+        std::vector<uint256_t> roots(num_blocks);
+        parallel_for(0, num_blocks, 1, [&](size_t lo, size_t hi) {
+            for (size_t b = lo; b < hi; b++) {
+                roots[b] = merkle_root(leaves + b * MERKLE_BLOCK_LEAVES, MERKLE_BLOCK_LEAVES, arity);
+            }
+        });
+        // A block spans this many levels at any of the allowed arities
+        size_t block_level = __builtin_ctzll(MERKLE_BLOCK_LEAVES) / __builtin_ctzll(arity);
+        for (const uint256_t &root : roots) {
+            push(root, block_level);
+        }
+        leaves += num_blocks * MERKLE_BLOCK_LEAVES;
+        n -= num_blocks * MERKLE_BLOCK_LEAVES;
+    }
+    for (size_t i = 0; i < n; i++) {
+        add(leaves[i]);
+    }
+}
+
+uint256_t MerkleAccumulator::root() const {
+    if (count == 0) {
+        uint256_t zero;
+        memset(zero.bytes, 0, 32);
+        return zero;
+    }
+    // carry is the last, incomplete node of level l, if any; it joins the
+    // pending nodes of its level and the group is padded with its last node
+    uint256_t carry, group[8];
+    bool has_carry = false;
+    for (size_t l = 0, unit = 1;; l++, unit *= arity) {
+        size_t complete = count / unit;
+        if (complete + has_carry == 1) {
+            return has_carry ? carry : frontier[l * arity];
+        }
+        size_t pending = complete % arity, k = 0;
+        if (pending == 0 && !has_carry) continue;
+        for (; k < pending; k++) group[k] = frontier[l * arity + k];
+        if (has_carry) group[k++] = carry;
+        for (; k < arity; k++) group[k] = group[k - 1];
+        carry = merkle_node(group, arity);
+        has_carry = true;
+    }
+}
+
+// File header of a saved MerkleTree; 32 bytes, so the nodes after it keep
+// their natural offsets.
+static const char MERKLE_FILE_MAGIC[8] = {'A', 'P', 'S', 'I', 'M', 'R', 'K', '1'};
+struct MerkleFileHeader {
+    char magic[8];
+    uint64_t leaves;
+    uint64_t arity;
+    uint64_t reserved;
+};
+
+MerkleTree::MerkleTree() : n(0), k(2), level_offsets(2, 0), nodes(nullptr), mapping(nullptr), mapping_bytes(0) {}
+
+// Level sizes follow from n and the arity alone: ceil(size / arity) up to 1.
+void MerkleTree::set_layout(size_t n, size_t arity) {
+    this->n = n;
+    this->k = arity;
+    level_offsets.assign(1, 0);
+    size_t size = n;
+    while (true) {
+        level_offsets.push_back(level_offsets.back() + size);
+        if (size <= 1) break;
+        size = (size + arity - 1) / arity;
+    }
+}
+
+MerkleTree::MerkleTree(const uint256_t *leaves, size_t n, size_t arity) : MerkleTree() {
+    check_merkle_arity(arity);
+    set_layout(n, arity);
+    owned.resize(level_offsets.back());
+    nodes = owned.data();
+    uint256_t *out = owned.data();
+    if (n == 0) return;
+    std::copy(leaves, leaves + n, out);
+
+    // Each block writes its slice of every level below the block level while
+    // it is in cache; a short last block is the end of each of those levels
+    size_t levels = num_levels() - 1;
+    size_t block_levels = __builtin_ctzll(MERKLE_BLOCK_LEAVES) / __builtin_ctzll(arity);
+    size_t inside = std::min(levels, block_levels);
+    size_t num_blocks = (n + MERKLE_BLOCK_LEAVES - 1) / MERKLE_BLOCK_LEAVES;
+    parallel_for(0, num_blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            const uint256_t *in = out + b * MERKLE_BLOCK_LEAVES;
+            size_t m = std::min(n - b * MERKLE_BLOCK_LEAVES, MERKLE_BLOCK_LEAVES);
+            size_t width = MERKLE_BLOCK_LEAVES;
+            for (size_t l = 0; l < inside; l++) {
+                width /= arity;
+                uint256_t *dst = out + level_offsets[l + 1] + b * width;
+                m = merkle_level(dst, in, m, arity);
+                in = dst;
+            }
+        }
+    });
+    for (size_t l = inside; l < levels; l++) {
+        merkle_level(out + level_offsets[l + 1], out + level_offsets[l], level_size(l), arity);
+    }
+}
+
+void MerkleTree::release() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_bytes);
+        mapping = nullptr;
+    }
+    owned.clear();
+    nodes = nullptr;
+}
+
+MerkleTree::~MerkleTree() {
+    release();
+}
+
+MerkleTree::MerkleTree(MerkleTree &&other) : MerkleTree() {
+    *this = std::move(other);
+}
+
+MerkleTree &MerkleTree::operator=(MerkleTree &&other) {
+    if (this != &other) {
+        release();
+        n = other.n;
+        k = other.k;
+        level_offsets = std::move(other.level_offsets);
+        owned = std::move(other.owned);
+        nodes = other.nodes;
+        mapping = other.mapping;
+        mapping_bytes = other.mapping_bytes;
+        other.level_offsets.assign(2, 0);
+        other.n = 0;
+        other.nodes = nullptr;
+        other.mapping = nullptr;
+    }
+    return *this;
+}
+
+uint256_t MerkleTree::root() const {
+    if (n == 0) {
+        uint256_t zero;
+        memset(zero.bytes, 0, 32);
+        return zero;
+    }
+    return nodes[level_offsets.back() - 1];
+}
+
+void MerkleTree::save(const std::string &path) const {
+    MerkleFileHeader header;
+    memcpy(header.magic, MERKLE_FILE_MAGIC, sizeof(header.magic));
+    header.leaves = n;
+    header.arity = k;
+    header.reserved = 0;
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+    size_t total = level_offsets.back();
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (total == 0 || fwrite(nodes, sizeof(uint256_t), total, f) == total);
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("Cannot write Merkle tree to " + path);
+    }
+}
+
+MerkleTree MerkleTree::load(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MerkleFileHeader)) {
+        close(fd);
+        throw std::runtime_error(path + " is not a Merkle tree file");
+    }
+    size_t bytes = (size_t)st.st_size;
+    void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+
+    MerkleTree tree;
+    tree.mapping = map;
+    tree.mapping_bytes = bytes;
+    MerkleFileHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, MERKLE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        (header.arity != 2 && header.arity != 4 && header.arity != 8)) {
+        throw std::runtime_error(path + " is not a Merkle tree file");
+    }
+    // The leaf count is untrusted: it must fit in the file before the level
+    // sizes are summed, and the sum is checked against the file size without
+    // overflowing
+    size_t capacity = (bytes - sizeof(header)) / sizeof(uint256_t);
+    if (header.leaves > capacity) {
+        throw std::runtime_error(path + " has the wrong size for its Merkle tree");
+    }
+    tree.set_layout(header.leaves, header.arity);
+    if (tree.level_offsets.back() != capacity ||
+        (bytes - sizeof(header)) % sizeof(uint256_t) != 0) {
+        throw std::runtime_error(path + " has the wrong size for its Merkle tree");
+    }
+    tree.nodes = (const uint256_t *)((const uint8_t *)map + sizeof(header));
+    return tree;
+}
+
+void MerkleTree::prove(uint256_t *out, size_t index) const {
+    if (index >= n) {
+        throw std::runtime_error("Merkle proof requested for a leaf out of range");
+    }
+    for (size_t l = 0; l + 1 < num_levels(); l++) {
+        const uint256_t *nodes_l = level(l);
+        size_t size = level_size(l), first = index - index % k;
+        for (size_t j = first; j < first + k; j++) {
+            if (j == index) continue;
+            *out++ = nodes_l[std::min(j, size - 1)];
+        }
+        index /= k;
+    }
+}
+
+vector<uint256_t> MerkleTree::prove(const size_t *indices, size_t count) const {
+    size_t len = proof_length();
+    vector<uint256_t> proofs(count * len);
+    parallel_for(0, count, 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            prove(proofs.data() + i * len, indices[i]);
+        }
+    });
+    return proofs;
+}
+
+bool merkle_verify(const uint256_t &root, const uint256_t &leaf, size_t index,
+                   size_t n, size_t arity, const uint256_t *proof) {
+    if (index >= n || (arity != 2 && arity != 4 && arity != 8)) return false;
+    uint256_t node = leaf, group[8];
+    for (size_t size = n; size > 1; size = (size + arity - 1) / arity) {
+        size_t pos = index % arity;
+        for (size_t j = 0; j < arity; j++) {
+            group[j] = j == pos ? node : *proof++;
+        }
+        node = merkle_node(group, arity);
+        index /= arity;
+    }
+    return node == root;
+}
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include "polynomial.hpp"
+#include "field_batch.hpp"
+
+// Once a subtree covers this few points, Horner on its remainder is cheaper
+// than dividing further.
+static const size_t TREE_LEAF_POINTS = 8;
+
+fe_poly prepare_poly(const vector<uint256_t>& coeffs) {
+    return prepare_poly(coeffs.data(), coeffs.size());
+}
+
+fe_poly prepare_poly(const uint256_t* coeffs, size_t n) {
+    fe_poly f(n);
+    for (size_t i = 0; i < n; i++) {
+        f[i] = fe_from_bytes(coeffs[i]);
+    }
+    return f;
+}
+
+// out[0 .. na+nb-2] = a * b, schoolbook.
+static void mul_schoolbook(fe25519* out, const fe25519* a, size_t na,
+                           const fe25519* b, size_t nb) {
+    for (size_t k = 0; k + 1 < na + nb; k++) {
+        out[k] = fe_zero();
+    }
+    for (size_t i = 0; i < na; i++) {
+        for (size_t j = 0; j < nb; j++) {
+            fe25519 t;
+            fe_mul(t, a[i], b[j]);
+            fe_add(out[i + j], out[i + j], t);
+        }
+    }
+}
+
+// out[0 .. 2n-2] = a * b for two operands of n coefficients each.
+static void mul_karatsuba(fe25519* out, const fe25519* a, const fe25519* b, size_t n) {
+    if (n < KARATSUBA_THRESHOLD) {
+        mul_schoolbook(out, a, n, b, n);
+        return;
+    }
+    // a = a0 + x^m a1, b = b0 + x^m b1, with |a0| = m and |a1| = n - m <= m
+    size_t m = (n + 1) / 2;
+    size_t h = n - m;
+
+    fe_poly sa(m), sb(m), mid(2 * m - 1);
+    for (size_t i = 0; i < m; i++) {
+        sa[i] = a[i];
+        sb[i] = b[i];
+        if (i < h) {
+            fe_add(sa[i], sa[i], a[m + i]);
+            fe_add(sb[i], sb[i], b[m + i]);
+        }
+    }
+    fe_poly low(2 * m - 1), high(2 * h - 1);
+    mul_karatsuba(low.data(), a, b, m);
+    mul_karatsuba(high.data(), a + m, b + m, h);
+    mul_karatsuba(mid.data(), sa.data(), sb.data(), m);
+
+    // mid = (a0 + a1)(b0 + b1) - a0 b0 - a1 b1
+    for (size_t i = 0; i < low.size(); i++) {
+        fe_sub(mid[i], mid[i], low[i]);
+    }
+    for (size_t i = 0; i < high.size(); i++) {
+        fe_sub(mid[i], mid[i], high[i]);
+    }
+
+    for (size_t i = 0; i + 1 < 2 * n; i++) {
+        out[i] = fe_zero();
+    }
+    for (size_t i = 0; i < low.size(); i++) {
+        fe_add(out[i], out[i], low[i]);
+    }
+    for (size_t i = 0; i < mid.size(); i++) {
+        fe_add(out[m + i], out[m + i], mid[i]);
+    }
+    for (size_t i = 0; i < high.size(); i++) {
+        fe_add(out[2 * m + i], out[2 * m + i], high[i]);
+    }
+}
+
+void poly_mul(fe_poly& h, const fe_poly& f, const fe_poly& g) {
+    if (f.empty() || g.empty()) {
+        h.clear();
+        return;
+    }
+    fe_poly result(f.size() + g.size() - 1);
+    if (std::min(f.size(), g.size()) < KARATSUBA_THRESHOLD) {
+        mul_schoolbook(result.data(), f.data(), f.size(), g.data(), g.size());
+    } else {
+        // Pad the shorter operand; subproduct trees only ever multiply
+        // operands of (nearly) equal size.
+        size_t n = std::max(f.size(), g.size());
+        fe_poly a(f), b(g), full(2 * n - 1);
+        a.resize(n, fe_zero());
+        b.resize(n, fe_zero());
+        mul_karatsuba(full.data(), a.data(), b.data(), n);
+        std::copy(full.begin(), full.begin() + result.size(), result.begin());
+    }
+    h.swap(result);
+}
+
+void poly_derivative(fe_poly& h, const fe_poly& f) {
+    fe_poly result(f.empty() ? 0 : f.size() - 1);
+    for (size_t i = 1; i < f.size(); i++) {
+        fe_mul_small(result[i - 1], f[i], (uint32_t)i);
+    }
+    h.swap(result);
+}
+
+// g = 1 / a mod x^len, for a[0] = 1. Each Newton step doubles the
+// precision: g += g * (1 - a g), where 1 - a g vanishes below x^l.
+static void inverse_series(fe_poly& g, const fe_poly& a, size_t len) {
+    g.assign(1, fe_one());
+    for (size_t l = 1; l < len; ) {
+        size_t l2 = std::min(2 * l, len);
+        fe_poly a_low(a.begin(), a.begin() + std::min(a.size(), l2)), t, v;
+        poly_mul(t, a_low, g);
+        fe_poly u(l2 - l, fe_zero());
+        for (size_t i = l; i < std::min(t.size(), l2); i++) {
+            u[i - l] = t[i];
+        }
+        poly_mul(v, g, u);
+        g.resize(l2, fe_zero());
+        for (size_t i = 0; i < l2 - l && i < v.size(); i++) {
+            fe_neg(g[l + i], v[i]);
+        }
+        l = l2;
+    }
+}
+
+// f mod m through the quotient: rev(q) = rev(f) / rev(m) mod x^(deg q + 1),
+// then r = f - q m, of which only the low deg m coefficients are needed.
+static void rem_newton(fe_poly& r, const fe_poly& f, const fe_poly& m) {
+    size_t dm = m.size() - 1;
+    size_t nq = f.size() - dm;
+    fe_poly rev_m(nq, fe_zero()), rev_f(nq), inv, rev_q;
+    for (size_t i = 0; i < nq && i <= dm; i++) {
+        rev_m[i] = m[dm - i];
+    }
+    for (size_t i = 0; i < nq; i++) {
+        rev_f[i] = f[f.size() - 1 - i];
+    }
+    inverse_series(inv, rev_m, nq);
+    poly_mul(rev_q, rev_f, inv);
+
+    size_t low = std::min(nq, dm);
+    fe_poly q(low), m_low(m.begin(), m.begin() + dm), qm;
+    for (size_t i = 0; i < low; i++) {
+        q[i] = rev_q[nq - 1 - i];
+    }
+    poly_mul(qm, q, m_low);
+    fe_poly rem(f.begin(), f.begin() + dm);
+    for (size_t i = 0; i < dm && i < qm.size(); i++) {
+        fe_sub(rem[i], rem[i], qm[i]);
+    }
+    r.swap(rem);
+}
+
+void poly_rem_monic(fe_poly& r, const fe_poly& f, const fe_poly& m) {
+    size_t dm = m.size() - 1;
+    if (f.size() <= dm) {
+        r = f;
+        return;
+    }
+    if (dm >= NEWTON_DIVISION_THRESHOLD && f.size() - dm >= NEWTON_DIVISION_THRESHOLD) {
+        rem_newton(r, f, m);
+        return;
+    }
+    fe_poly rem(f);
+    // Cancel the leading term of rem against x^k * m, from the top down.
+    for (size_t k = f.size() - 1; k >= dm; k--) {
+        const fe25519 lead = rem[k];
+        for (size_t j = 0; j < dm; j++) {
+            fe25519 t;
+            fe_mul(t, lead, m[j]);
+            fe_sub(rem[k - dm + j], rem[k - dm + j], t);
+        }
+        if (k == dm) break;
+    }
+    rem.resize(dm);
+    r.swap(rem);
+}
+
+fe25519 poly_eval(const fe_poly& f, const fe25519& x) {
+    fe25519 acc = fe_zero();
+    for (size_t i = f.size(); i > 0; i--) {
+        fe_mul_add(acc, acc, x, f[i - 1]);
+    }
+    return acc;
+}
+
+SubproductTree::SubproductTree(const fe25519* points, size_t n) : num_points(n) {
+    levels.emplace_back(n);
+    for (size_t i = 0; i < n; i++) {
+        fe_poly& leaf = levels[0][i];
+        leaf.resize(2);
+        fe_neg(leaf[0], points[i]);
+        leaf[1] = fe_one();
+    }
+    while (levels.back().size() > 1) {
+        const vector<fe_poly>& below = levels.back();
+        vector<fe_poly> above((below.size() + 1) / 2);
+        for (size_t j = 0; j < above.size(); j++) {
+            if (2 * j + 1 < below.size()) {
+                poly_mul(above[j], below[2 * j], below[2 * j + 1]);
+            } else {
+                above[j] = below[2 * j];
+            }
+        }
+        levels.push_back(std::move(above));
+    }
+}
+
+// Evaluates the remainder r (already reduced modulo node (level, j)) at the
+// points that node covers.
+static void descend(fe25519* out, const fe_poly& r, const SubproductTree& tree,
+                    const fe25519* points, size_t level, size_t j) {
+    size_t first = j << level;
+    size_t last = std::min(first + ((size_t)1 << level), tree.num_points);
+
+    if (last - first <= TREE_LEAF_POINTS || level == 0) {
+        fe_poly_eval_batch(out + first, r.data(), r.size(), points + first, last - first);
+        return;
+    }
+
+    const vector<fe_poly>& children = tree.levels[level - 1];
+    for (size_t c = 2 * j; c < std::min(2 * j + 2, children.size()); c++) {
+        fe_poly child_rem;
+        poly_rem_monic(child_rem, r, children[c]);
+        descend(out, child_rem, tree, points, level - 1, c);
+    }
+}
+
+void multipoint_eval(fe25519* out, const fe_poly& f, const SubproductTree& tree,
+                     const fe25519* points) {
+    if (tree.num_points == 0) return;
+    fe_poly r;
+    poly_rem_monic(r, f, tree.root());
+    descend(out, r, tree, points, tree.levels.size() - 1, 0);
+}
+
+void multipoint_eval(fe25519* out, const fe_poly& f, const fe25519* points, size_t n) {
+    if (n < MULTIPOINT_TREE_THRESHOLD) {
+        fe_poly_eval_batch(out, f.data(), f.size(), points, n);
+        return;
+    }
+    SubproductTree tree(points, n);
+    multipoint_eval(out, f, tree, points);
+}
+
+// Quadratic Lagrange interpolation with all denominators inverted at once.
+static void interpolate_quadratic(fe_poly& P, const fe25519* xs, const fe25519* ys, size_t n) {
+    // M(x) = prod (x - x_i), monic of degree n
+    fe_poly M(n + 1, fe_zero());
+    M[0] = fe_one();
+    for (size_t i = 0; i < n; i++) {
+        for (size_t k = i + 1; k > 0; k--) {
+            fe25519 t;
+            fe_mul(t, M[k], xs[i]);
+            fe_sub(M[k], M[k - 1], t);
+        }
+        fe_mul(M[0], M[0], xs[i]);
+        fe_neg(M[0], M[0]);
+    }
+
+    // w_i = y_i / M'(x_i)
+    fe_poly dM;
+    poly_derivative(dM, M);
+    vector<fe25519> w(n);
+    fe_poly_eval_batch(w.data(), dM.data(), dM.size(), xs, n);
+    fe_batch_invert(w.data(), w.data(), n);
+    for (size_t i = 0; i < n; i++) {
+        fe_mul(w[i], w[i], ys[i]);
+    }
+
+    // P = sum w_i * M / (x - x_i), each quotient by synthetic division
+    fe_poly result(n, fe_zero());
+    fe_poly q(n);
+    for (size_t i = 0; i < n; i++) {
+        q[n - 1] = M[n];
+        for (size_t k = n - 1; k > 0; k--) {
+            fe25519 t;
+            fe_mul(t, q[k], xs[i]);
+            fe_add(q[k - 1], M[k], t);
+        }
+        for (size_t k = 0; k < n; k++) {
+            fe25519 t;
+            fe_mul(t, q[k], w[i]);
+            fe_add(result[k], result[k], t);
+        }
+    }
+    P.swap(result);
+}
+
+// Subproduct-tree interpolation: weights from one multipoint evaluation of
+// M', then a bottom-up linear combination r = r_l * M_r + r_r * M_l.
+static void interpolate_tree(fe_poly& P, const fe25519* xs, const fe25519* ys, size_t n) {
+    SubproductTree tree(xs, n);
+
+    fe_poly dM;
+    poly_derivative(dM, tree.root());
+    vector<fe25519> w(n);
+    multipoint_eval(w.data(), dM, tree, xs);
+    fe_batch_invert(w.data(), w.data(), n);
+
+    vector<fe_poly> current(n);
+    for (size_t i = 0; i < n; i++) {
+        current[i].resize(1);
+        fe_mul(current[i][0], w[i], ys[i]);
+    }
+
+    for (size_t level = 0; level + 1 < tree.levels.size(); level++) {
+        const vector<fe_poly>& nodes = tree.levels[level];
+        vector<fe_poly> next((current.size() + 1) / 2);
+        for (size_t j = 0; j < next.size(); j++) {
+            if (2 * j + 1 < current.size()) {
+                fe_poly left, right;
+                poly_mul(left, current[2 * j], nodes[2 * j + 1]);
+                poly_mul(right, current[2 * j + 1], nodes[2 * j]);
+                next[j].resize(std::max(left.size(), right.size()), fe_zero());
+                for (size_t k = 0; k < left.size(); k++) {
+                    fe_add(next[j][k], next[j][k], left[k]);
+                }
+                for (size_t k = 0; k < right.size(); k++) {
+                    fe_add(next[j][k], next[j][k], right[k]);
+                }
+            } else {
+                next[j].swap(current[2 * j]);
+            }
+        }
+        current.swap(next);
+    }
+
+    P.swap(current[0]);
+    P.resize(n, fe_zero());
+}
+
+void interpolate(fe_poly& P, const fe25519* xs, const fe25519* ys, size_t n) {
+    if (n == 0) {
+        P.clear();
+        return;
+    }
+    if (n < INTERPOLATE_TREE_THRESHOLD) {
+        interpolate_quadratic(P, xs, ys, n);
+    } else {
+        interpolate_tree(P, xs, ys, n);
+    }
+}
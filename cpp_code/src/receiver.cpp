@@ -1,4 +1,7 @@
 #include "receiver.hpp"
+#include <tuple>
+#include <algorithm>
+#include "thread_pool.hpp"
 
 // Receiver Constructor
 Receiver::Receiver(const uint256_t *input, size_t input_len) {
@@ -6,8 +9,10 @@ Receiver::Receiver(const uint256_t *input, size_t input_len) {
     this->input_len = input_len;
 
     ka_messages = vector<uint256_t>();
-    polys = vector<vector<uint256_t>>();
+    polys = BinTable();
     merkle_root = uint256_t();
+    merkle_arity = 2;
+    commit_domain = CommitDomain::ROOTS_OF_UNITY;
 }
 
 // Receiver commitment
@@ -19,38 +24,58 @@ void Receiver::commit(){
     
     // 2. Create uniform hashing table.
     size_t bin_size = this->input_len / log2(this->input_len); // n/log(n)
-    vector<vector<uint256_t>> T_Rec(bin_size);
     
     // Hash each input message and place it into the correct bin using H_1(input)
-    for (const auto& current_message : this->input) {
-        uint8_t hash[32];
+    this->digests.compute(this->input.data(), this->input_len);
+    this->digests.assign_bins(bin_size, this->bin_config.strategy);
+    const BinPartition& T_Rec = this->digests.partition;
+    BinTable H1_table = gather_bins(this->digests.h1.data(), this->digests.partition);
+    BinTable ka_table = gather_bins(this->ka_messages.data(), this->digests.partition);
+    size_t total_bins = T_Rec.num_bins(); // a cuckoo stash is one more bin
 
-        uint256_t h1_message = H_1(current_message);
-        crypto_blake2b(hash, sizeof(hash), h1_message.bytes, 32);
-
-        size_t bin_index = H_bin(hash, bin_size);
-        T_Rec[bin_index].push_back(current_message);
+    // Points per bin after dummies. Padding brings every regular bin to the
+    // largest load, fixed-degree mode to one public length. The stash is only
+    // padded when used, to its capacity: an empty stash must stay empty, or
+    // the sender would add every element to it. Outside the simple scheme a
+    // lone element gets a dummy, so no bin has a constant polynomial.
+    bool pad = this->bin_config.pad || this->bin_config.fixed_degree;
+    bool simple = this->bin_config.strategy == BinStrategy::SIMPLE;
+    size_t padded_load = std::max<size_t>(this->digests.max_load, 2);
+    size_t fixed_load = 0;
+    if (this->bin_config.fixed_degree) {
+        fixed_load = std::max(fixed_bin_load(this->input_len, bin_size, this->bin_config.strategy), padded_load);
+        padded_load = fixed_load;
     }
+    auto bin_target = [&](size_t i, size_t count) -> size_t {
+        if (pad && i < bin_size) return padded_load;
+        if (pad && count != 0) return CUCKOO_STASH_SIZE;
+        if (!simple && count == 1) return 2;
+        return count;
+    };
     
-    // 3. Create polynomials using (H_1(y_i), ka_message_i) pairs
-    size_t ka_counter = 0;
-    for (size_t i = 0; i < bin_size; i++) {
-
-        const auto& bin_elements = T_Rec[i];
-        if (bin_elements.empty()) continue;
-    
-        vector<uint256_t> H1_values;
-        vector<uint256_t> ka_messages_for_bin;
+    // 3. Create polynomials using (H_1(y_i), ka_message_i) pairs. Both are
+    // gathered through the bin's element indices, so y_i keeps its own
+    // ka_message_i; empty bins keep an empty polynomial.
+    vector<vector<uint256_t>> bin_polys(total_bins);
+    parallel_for(0, total_bins, 0, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            size_t count = T_Rec.bin_size(i);
+            size_t target = bin_target(i, count);
+            if (target == 0) continue;
+            vector<uint256_t> H1_values(H1_table.bin(i), H1_table.bin(i) + count); // H_1(y_i)
+            vector<uint256_t> ka_messages_for_bin(ka_table.bin(i), ka_table.bin(i) + count);
+            pad_with_dummies(H1_values, ka_messages_for_bin, target);
 
-        for (const auto& element : bin_elements) {
-            H1_values.push_back(H_1(element)); // H_1(y_i)
-            ka_messages_for_bin.push_back(this->ka_messages[ka_counter]);
-            ka_counter++;
+            bin_polys[i] = Lagrange_Polynomial(H1_values, ka_messages_for_bin);
+            // Keep vanishing leading coefficients, so every length stays target
+            if (i < bin_size) {
+                bin_polys[i].resize(std::max(bin_polys[i].size(), fixed_load), uint256_t());
+            }
         }
+    });
+    this->polys = flatten_bins(bin_polys);
 
-        this->polys.push_back(Lagrange_Polynomial(H1_values, ka_messages_for_bin));
-    }
-
-    // 4. Merkle tree root using the evaluations at roots of unity.
-    this->merkle_root = Merkle_Root_Receiver(this->polys, this->input_len);
+    // 4. Merkle tree root using the evaluations over the commitment domain.
+    this->merkle_root = Merkle_Root_Receiver(this->polys, this->polys.values.size(), this->merkle_arity,
+                                             this->commit_domain);
 }
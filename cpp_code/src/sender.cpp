@@ -1,10 +1,17 @@
 #include "sender.hpp"
 #include "network.hpp"
-#include <random>
+#include "drbg.hpp"
+#include "merkle.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <stdexcept>
 
 using std::vector;
-using std::random_device;
+
+// Leaves hashed per chunk of the commitment: a few Merkle blocks, so every
+// chunk still spreads over the thread pool.
+static const size_t SENDER_LEAF_CHUNK = 16 * MERKLE_BLOCK_LEAVES;
 
 // Sender Constructor
 Sender::Sender(const uint256_t *input, size_t input_len) {
@@ -13,28 +20,97 @@ Sender::Sender(const uint256_t *input, size_t input_len) {
     random_values = vector<uint256_t>();
     merkle_root = uint256_t();
     merkle_leaves = vector<uint256_t>();
+    merkle_arity = 2;
+}
+
+// Reuses the commitment saved by an earlier commit(): the random values are
+// read back and every leaf is recomputed from them and checked against the
+// mapped tree, so a file for another input or arity only costs a rebuild.
+// The inner nodes are trusted as written.
+bool Sender::load_commitment() {
+    FILE *f = fopen((this->merkle_tree_path + ".rand").c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    this->random_values.resize(this->input_len);
+    bool ok = fread(this->random_values.data(), sizeof(uint256_t), this->input_len, f) == this->input_len &&
+              fgetc(f) == EOF;
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    MerkleTree tree;
+    try {
+        tree = MerkleTree::load(this->merkle_tree_path);
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    if (tree.size() != this->input_len || tree.arity() != this->merkle_arity) {
+        return false;
+    }
+    this->merkle_leaves.resize(this->input_len);
+    concatenate_and_hash_batch(this->merkle_leaves.data(), this->input.data(), this->random_values.data(),
+                               this->input_len);
+    if (this->input_len != 0 &&
+        memcmp(this->merkle_leaves.data(), tree.leaves(), this->input_len * sizeof(uint256_t)) != 0) {
+        return false;
+    }
+    this->merkle_tree = std::move(tree);
+    this->merkle_root = this->merkle_tree.root();
+    return true;
+}
+
+void Sender::save_commitment() const {
+    this->merkle_tree.save(this->merkle_tree_path);
+    std::string path = this->merkle_tree_path + ".rand";
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+    bool ok = fwrite(this->random_values.data(), sizeof(uint256_t), this->input_len, f) == this->input_len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("Cannot write random values to " + path);
+    }
 }
 
 // Sender Commitment
 void Sender::commit(){
+    // A commitment saved for this input replaces steps 1 and 2
+    if (!this->merkle_tree_path.empty() && this->load_commitment()) {
+        this->digests.compute(this->input.data(), this->input_len);
+        return;
+    }
+
     this->random_values.resize(this->input_len);
     this->merkle_leaves.resize(this->input_len);
     
     // 1. Generate input_len random field elements.
-    for (size_t i = 0; i < this->input_len; i++) {
-        uint8_t random_value[32];
-        random_device rd;
-        for (size_t j = 0; j < 32; j++) {
-            random_value[j] = rd() & 0xFF;
-        }
-        memcpy(&this->random_values[i].bytes, random_value, 32);
-    }
+    ChaChaDrbg::local().fill(this->random_values.data(), this->input_len);
     
     // 2. Compute the Merkle leaves using concatenation and H_1
-    for (size_t k = 0; k < this->input_len; k++) {
-        // Use concatenate_and_hash which effectively does H_1(x_i || r_i)
-        this->merkle_leaves[k] = concatenate_and_hash(this->input[k], this->random_values[k]);
+    // concatenate_and_hash effectively does H_1(x_i || r_i). Leaves go into
+    // the tree a chunk at a time, while they are still in cache; a tree that
+    // is saved keeps every level instead.
+    bool persist = !this->merkle_tree_path.empty();
+    MerkleAccumulator tree(this->merkle_arity);
+    for (size_t lo = 0; lo < this->input_len; lo += SENDER_LEAF_CHUNK) {
+        size_t count = std::min(SENDER_LEAF_CHUNK, this->input_len - lo);
+        uint256_t *leaves = this->merkle_leaves.data() + lo;
+        concatenate_and_hash_batch(leaves, this->input.data() + lo, this->random_values.data() + lo, count);
+        if (!persist) {
+            tree.add(leaves, count);
+        }
+    }
+    if (persist) {
+        this->merkle_tree = MerkleTree(this->merkle_leaves.data(), this->input_len, this->merkle_arity);
+        this->merkle_root = this->merkle_tree.root();
+        this->save_commitment();
+    } else {
+        this->merkle_root = tree.root();
     }
-    this->merkle_root = Merkle_Root_Sender(this->merkle_leaves);
-}
 
+    // 3. H_1 and bin hash of every input, reused by intersect()
+    this->digests.compute(this->input.data(), this->input_len);
+}
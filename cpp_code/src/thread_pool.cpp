@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <exception>
+#include "thread_pool.hpp"
+
+// Which pool and queue the current thread works for (queue 0 if none).
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+static size_t configured_threads = 0;
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : num_threads(std::max<size_t>(num_threads, 1)), queued(0), stopping(false) {
+    for (size_t i = 0; i < this->num_threads; i++) {
+        queues.emplace_back(new TaskQueue());
+    }
+    for (size_t i = 1; i < this->num_threads; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::push(size_t self, std::function<void()> task) {
+    // Count first so the counter never dips below the number of tasks queued
+    queued++;
+    std::lock_guard<std::mutex> lock(queues[self]->m);
+    queues[self]->tasks.push_back(std::move(task));
+}
+
+bool ThreadPool::run_one(size_t self) {
+    std::function<void()> task;
+    // Newest own task first (still warm in cache), then the oldest task of
+    // the next non-empty queue
+    for (size_t k = 0; k < num_threads && !task; k++) {
+        TaskQueue& q = *queues[(self + k) % num_threads];
+        std::lock_guard<std::mutex> lock(q.m);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    queued--;
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t self) {
+    current_pool = this;
+    current_queue = self;
+    while (true) {
+        if (run_one(self)) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain,
+                              const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) return;
+    size_t n = end - begin;
+    if (grain == 0) {
+        // Alone, one chunk is as good as several
+        grain = num_threads == 1 ? n : std::max<size_t>(1, n / (4 * num_threads));
+    }
+    if (num_threads == 1 || n <= grain) {
+        // Inline, but still in chunks of at most grain: callers size their
+        // buffers by it
+        for (size_t lo = begin; lo < end; ) {
+            size_t hi = lo + std::min(grain, end - lo);
+            body(lo, hi);
+            lo = hi;
+        }
+        return;
+    }
+
+    size_t self = current_pool == this ? current_queue : 0;
+    size_t chunks = (n + grain - 1) / grain;
+    std::atomic<size_t> remaining(chunks);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    // The caller takes the first chunk itself, everything else is up for grabs
+    for (size_t c = 1; c < chunks; c++) {
+        size_t lo = begin + c * grain, hi = std::min(end, lo + grain);
+        push(self, [&, lo, hi] {
+            try {
+                body(lo, hi);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+            remaining--;
+        });
+    }
+    {
+        // Taking the lock orders the push before a worker's sleep check
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_all();
+
+    try {
+        body(begin, std::min(end, begin + grain));
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+    }
+    remaining--;
+
+    while (remaining > 0) {
+        if (!run_one(self)) std::this_thread::yield();
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(default_threads());
+    return pool;
+}
+
+void ThreadPool::set_default_threads(size_t n) {
+    configured_threads = n;
+}
+
+size_t ThreadPool::default_threads() {
+    if (configured_threads != 0) return configured_threads;
+    return std::max<unsigned>(1, std::thread::hardware_concurrency());
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& body) {
+    ThreadPool::instance().parallel_for(begin, end, grain, body);
+}
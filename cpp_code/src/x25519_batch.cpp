@@ -0,0 +1,234 @@
+#include <cstring>
+#include "x25519_batch.hpp"
+#include "field.hpp"
+#include "field_batch.hpp"
+#include "field_avx2.hpp"
+#include "thread_pool.hpp"
+
+// Same trimming as crypto_eddsa_trim_scalar().
+static void trim_scalar(uint8_t out[32], const uint8_t in[32]) {
+    memcpy(out, in, 32);
+    out[0] &= 248;
+    out[31] &= 127;
+    out[31] |= 64;
+}
+
+static int scalar_bit(const uint8_t s[32], int i) {
+    return (s[i >> 3] >> (i & 7)) & 1;
+}
+
+// Loads a u-coordinate the way monocypher does, ignoring bit 255.
+static fe25519 load_u(const uint8_t point[32]) {
+    uint8_t u[32];
+    memcpy(u, point, 32);
+    u[31] &= 0x7f;
+    return fe_from_bytes(u);
+}
+
+// Montgomery ladder over the 255 bits of a trimmed scalar; leaves the
+// projective result in (x2 : z2). Step for step the same as monocypher's
+// scalarmult().
+static void ladder_scalar(fe25519 &x2, fe25519 &z2, const uint8_t scalar[32], const fe25519 &x1) {
+    fe25519 x3 = x1, z3 = fe_one(), t0, t1;
+    x2 = fe_one();
+    z2 = fe_zero();
+    uint64_t swap = 0;
+    for (int pos = 254; pos >= 0; --pos) {
+        uint64_t b = scalar_bit(scalar, pos);
+        swap ^= b;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = b;
+
+        fe_sub(t0, x3, z3);
+        fe_sub(t1, x2, z2);
+        fe_add(x2, x2, z2);
+        fe_add(z2, x3, z3);
+        fe_mul(z3, t0, x2);
+        fe_mul(z2, z2, t1);
+        fe_sq (t0, t1    );
+        fe_sq (t1, x2    );
+        fe_add(x3, z3, z2);
+        fe_sub(z2, z3, z2);
+        fe_mul(x2, t1, t0);
+        fe_sub(t1, t1, t0);
+        fe_sq (z2, z2    );
+        fe_mul_small(z3, t1, 121666);
+        fe_sq (x3, x3    );
+        fe_add(t0, t0, z3);
+        fe_mul(z3, x1, z2);
+        fe_mul(z2, t1, t0);
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+}
+
+#ifdef APSI_HAVE_AVX2_KERNELS
+
+// Four ladders in lockstep. Each lane follows its own scalar bits through
+// per-lane swap masks, so lanes never branch apart.
+APSI_AVX2 static void ladder4_avx2(fe25519 x2_out[4], fe25519 z2_out[4],
+                                   const uint8_t scalars[4][32], const fe25519x4 &x1) {
+    static const uint64_t ONE[10] = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    static const uint64_t ZERO[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    fe25519x4 x2, z2, x3, z3, t0, t1;
+    fe4_broadcast(x2, ONE);
+    fe4_broadcast(z2, ZERO);
+    x3 = x1;
+    fe4_broadcast(z3, ONE);
+
+    __m256i swap = _mm256_setzero_si256();
+    for (int pos = 254; pos >= 0; --pos) {
+        __m256i b = _mm256_set_epi64x(-(long long)scalar_bit(scalars[3], pos),
+                                      -(long long)scalar_bit(scalars[2], pos),
+                                      -(long long)scalar_bit(scalars[1], pos),
+                                      -(long long)scalar_bit(scalars[0], pos));
+        swap = _mm256_xor_si256(swap, b);
+        fe4_cswap(x2, x3, swap);
+        fe4_cswap(z2, z3, swap);
+        swap = b;
+
+        fe4_sub(t0, x3, z3);
+        fe4_sub(t1, x2, z2);
+        fe4_add(x2, x2, z2);
+        fe4_add(z2, x3, z3);
+        fe4_mul(z3, t0, x2);
+        fe4_mul(z2, z2, t1);
+        fe4_sq (t0, t1    );
+        fe4_sq (t1, x2    );
+        fe4_add(x3, z3, z2);
+        fe4_sub(z2, z3, z2);
+        fe4_mul(x2, t1, t0);
+        fe4_sub(t1, t1, t0);
+        fe4_sq (z2, z2    );
+        fe4_mul_small(z3, t1, 121666);
+        fe4_sq (x3, x3    );
+        fe4_add(t0, t0, z3);
+        fe4_mul(z3, x1, z2);
+        fe4_mul(z2, t1, t0);
+    }
+    fe4_cswap(x2, x3, swap);
+    fe4_cswap(z2, z3, swap);
+
+    fe4_store(x2_out, x2, 4);
+    fe4_store(z2_out, z2, 4);
+}
+
+#endif
+
+// Runs every ladder and leaves projective results in X and Z. A step of 0
+// reuses the same scalar (or point) for every element.
+static void ladder_batch(fe25519 *X, fe25519 *Z,
+                         const uint256_t *scalars, size_t scalar_step,
+                         const uint256_t *points, size_t point_step, size_t n) {
+    size_t i = 0;
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        for (; i + 4 <= n; i += 4) {
+            uint8_t e[4][32];
+            fe25519 u[4];
+            for (int lane = 0; lane < 4; lane++) {
+                trim_scalar(e[lane], scalars[(i + lane) * scalar_step].bytes);
+                u[lane] = load_u(points[(i + lane) * point_step].bytes);
+            }
+            fe25519x4 x1;
+            fe4_load(x1, u, 4);
+            ladder4_avx2(X + i, Z + i, e, x1);
+            crypto_wipe(e, sizeof(e));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        uint8_t e[32];
+        trim_scalar(e, scalars[i * scalar_step].bytes);
+        ladder_scalar(X[i], Z[i], e, load_u(points[i * point_step].bytes));
+        crypto_wipe(e, sizeof(e));
+    }
+}
+
+// ladder_batch() for one scalar against points[first .. first + n) of a
+// FieldBatch; whole groups go straight into the AVX2 ladder.
+static void ladder_batch(fe25519 *X, fe25519 *Z, const uint256_t &scalar,
+                         const FieldBatch &points, size_t first, size_t n) {
+    uint8_t e[32];
+    trim_scalar(e, scalar.bytes);
+    size_t i = 0;
+#ifdef APSI_HAVE_AVX2_KERNELS
+    if (field_batch_avx2()) {
+        uint8_t e4[4][32];
+        for (int lane = 0; lane < 4; lane++) memcpy(e4[lane], e, 32);
+        for (; i < n && (first + i) % 4 != 0; i++) {
+            ladder_scalar(X[i], Z[i], e, points.get(first + i));
+        }
+        for (; i + 4 <= n; i += 4) {
+            fe25519x4 x1;
+            fe4_load_group(x1, points.group((first + i) / 4));
+            ladder4_avx2(X + i, Z + i, e4, x1);
+        }
+        crypto_wipe(e4, sizeof(e4));
+    }
+#endif
+    for (; i < n; i++) {
+        ladder_scalar(X[i], Z[i], e, points.get(first + i));
+    }
+    crypto_wipe(e, sizeof(e));
+}
+
+// Ladders a chunk at a time and converts each chunk to affine with a single
+// shared inversion of all its Z coordinates. ladders(X, Z, start, count)
+// runs the ladders of elements start .. start + count.
+template <class Ladders>
+static void x25519_batch_impl(uint256_t *out, size_t n, size_t batch_size, const Ladders &ladders) {
+    if (batch_size == 0) batch_size = 1;
+
+    // Each batch (one shared inversion) is a task of its own
+    parallel_for(0, n, batch_size, [&](size_t start, size_t end) {
+        size_t count = end - start;
+        vector<fe25519> X(count), Z(count);
+        ladders(X.data(), Z.data(), start, count);
+
+        // Z = 0 (small-order inputs) inverts to 0, so X * 0 gives the same
+        // 0 crypto_x25519 returns.
+        fe_batch_invert(Z.data(), Z.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            fe_mul(X[i], X[i], Z[i]);
+            out[start + i] = fe_to_bytes(X[i]);
+        }
+        crypto_wipe(X.data(), count * sizeof(fe25519));
+        crypto_wipe(Z.data(), count * sizeof(fe25519));
+    });
+}
+
+// Byte inputs; a step of 0 reuses the same scalar (or point) throughout.
+static void x25519_batch_bytes(uint256_t *out,
+                               const uint256_t *scalars, size_t scalar_step,
+                               const uint256_t *points, size_t point_step,
+                               size_t n, size_t batch_size) {
+    x25519_batch_impl(out, n, batch_size, [&](fe25519 *X, fe25519 *Z, size_t start, size_t count) {
+        ladder_batch(X, Z, scalars + start * scalar_step, scalar_step,
+                     points + start * point_step, point_step, count);
+    });
+}
+
+void x25519_batch(uint256_t *out, const uint256_t *scalars, const uint256_t *points,
+                  size_t n, size_t batch_size) {
+    x25519_batch_bytes(out, scalars, 1, points, 1, n, batch_size);
+}
+
+void x25519_batch(uint256_t *out, const uint256_t &scalar, const uint256_t *points,
+                  size_t n, size_t batch_size) {
+    x25519_batch_bytes(out, &scalar, 0, points, 1, n, batch_size);
+}
+
+void x25519_batch(uint256_t *out, const uint256_t *scalars, const uint256_t &point,
+                  size_t n, size_t batch_size) {
+    x25519_batch_bytes(out, scalars, 1, &point, 0, n, batch_size);
+}
+
+void x25519_batch(uint256_t *out, const uint256_t &scalar, const FieldBatch &points,
+                  size_t batch_size) {
+    x25519_batch_impl(out, points.size(), batch_size, [&](fe25519 *X, fe25519 *Z, size_t start, size_t count) {
+        ladder_batch(X, Z, scalar, points, start, count);
+    });
+}